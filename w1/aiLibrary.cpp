@@ -1,6 +1,7 @@
 #include "aiLibrary.h"
 #include <flecs.h>
 #include "ecsTypes.h"
+#include "math.h"
 #include <bx/rng.h>
 #include <cfloat>
 #include <cmath>
@@ -15,15 +16,6 @@ public:
   void act(float/* dt*/, flecs::world &/*ecs*/, flecs::entity /*entity*/) const override {}
 };
 
-template<typename T>
-T sqr(T a){ return a*a; }
-
-template<typename T, typename U>
-static float dist_sq(const T &lhs, const U &rhs) { return float(sqr(lhs.x - rhs.x) + sqr(lhs.y - rhs.y)); }
-
-template<typename T, typename U>
-static float dist(const T &lhs, const U &rhs) { return sqrtf(dist_sq(lhs, rhs)); }
-
 template<typename T, typename U>
 static int move_towards(const T &from, const U &to)
 {
@@ -69,6 +61,63 @@ static void on_closest_enemy_pos(flecs::world &ecs, flecs::entity entity, Callab
   });
 }
 
+void move_to_enemy_act(flecs::world &ecs, flecs::entity entity)
+{
+  on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
+  {
+    a.action = move_towards(pos, enemy_pos);
+  });
+}
+
+void flee_from_enemy_act(flecs::world &ecs, flecs::entity entity)
+{
+  on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
+  {
+    a.action = inverse_move(move_towards(pos, enemy_pos));
+  });
+}
+
+void patrol_act(flecs::world &/*ecs*/, flecs::entity entity, float patrol_dist)
+{
+  entity.set([&](const Position &pos, const PatrolPos &ppos, Action &a)
+  {
+    if (dist(pos, ppos) > patrol_dist)
+      a.action = move_towards(pos, ppos); // do a recovery walk
+    else
+    {
+      // do a random walk
+      a.action = EA_MOVE_START + (rng.gen() % (EA_MOVE_END - EA_MOVE_START));
+    }
+  });
+}
+
+bool is_enemy_available(flecs::world &ecs, flecs::entity entity, float trigger_dist)
+{
+  static auto enemiesQuery = ecs.query<const Position, const Team>();
+  bool enemiesFound = false;
+  entity.get([&](const Position &pos, const Team &t)
+  {
+    enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
+    {
+      if (t.team == et.team)
+        return;
+      float curDist = dist(epos, pos);
+      enemiesFound |= curDist <= trigger_dist;
+    });
+  });
+  return enemiesFound;
+}
+
+bool is_hitpoints_less_than(flecs::entity entity, float thres)
+{
+  bool hitpointsThresholdReached = false;
+  entity.get([&](const Hitpoints &hp)
+  {
+    hitpointsThresholdReached |= hp.hitpoints < thres;
+  });
+  return hitpointsThresholdReached;
+}
+
 class MoveToEnemyState : public State
 {
 public:
@@ -76,10 +125,7 @@ public:
   void exit() const override {}
   void act(float/* dt*/, flecs::world &ecs, flecs::entity entity) const override
   {
-    on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
-    {
-      a.action = move_towards(pos, enemy_pos);
-    });
+    move_to_enemy_act(ecs, entity);
   }
 };
 
@@ -91,10 +137,7 @@ public:
   void exit() const override {}
   void act(float/* dt*/, flecs::world &ecs, flecs::entity entity) const override
   {
-    on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
-    {
-      a.action = inverse_move(move_towards(pos, enemy_pos));
-    });
+    flee_from_enemy_act(ecs, entity);
   }
 };
 
@@ -107,16 +150,7 @@ public:
   void exit() const override {}
   void act(float/* dt*/, flecs::world &ecs, flecs::entity entity) const override
   {
-    entity.set([&](const Position &pos, const PatrolPos &ppos, Action &a)
-    {
-      if (dist(pos, ppos) > patrolDist)
-        a.action = move_towards(pos, ppos); // do a recovery walk
-      else
-      {
-        // do a random walk
-        a.action = EA_MOVE_START + (rng.gen() % (EA_MOVE_END - EA_MOVE_START));
-      }
-    });
+    patrol_act(ecs, entity, patrolDist);
   }
 };
 
@@ -135,19 +169,7 @@ public:
   EnemyAvailableTransition(float in_dist) : triggerDist(in_dist) {}
   bool isAvailable(flecs::world &ecs, flecs::entity entity) const override
   {
-    static auto enemiesQuery = ecs.query<const Position, const Team>();
-    bool enemiesFound = false;
-    entity.get([&](const Position &pos, const Team &t)
-    {
-      enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
-      {
-        if (t.team == et.team)
-          return;
-        float curDist = dist(epos, pos);
-        enemiesFound |= curDist <= triggerDist;
-      });
-    });
-    return enemiesFound;
+    return is_enemy_available(ecs, entity, triggerDist);
   }
 };
 
@@ -156,14 +178,9 @@ class HitpointsLessThanTransition : public StateTransition
   float threshold;
 public:
   HitpointsLessThanTransition(float in_thres) : threshold(in_thres) {}
-  bool isAvailable(flecs::world &ecs, flecs::entity entity) const override
+  bool isAvailable(flecs::world &/*ecs*/, flecs::entity entity) const override
   {
-    bool hitpointsThresholdReached = false;
-    entity.get([&](const Hitpoints &hp)
-    {
-      hitpointsThresholdReached |= hp.hitpoints < threshold;
-    });
-    return hitpointsThresholdReached;
+    return is_hitpoints_less_than(entity, threshold);
   }
 };
 
@@ -16,3 +16,10 @@ StateTransition *create_hitpoints_less_than_transition(float thres);
 StateTransition *create_negate_transition(StateTransition *in);
 StateTransition *create_and_transition(StateTransition *lhs, StateTransition *rhs);
 
+
+// behaviours behind the states and transitions above, also used by table-driven fsms
+void move_to_enemy_act(flecs::world &ecs, flecs::entity entity);
+void flee_from_enemy_act(flecs::world &ecs, flecs::entity entity);
+void patrol_act(flecs::world &ecs, flecs::entity entity, float patrol_dist);
+bool is_enemy_available(flecs::world &ecs, flecs::entity entity, float trigger_dist);
+bool is_hitpoints_less_than(flecs::entity entity, float thres);
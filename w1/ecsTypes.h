@@ -107,6 +107,12 @@ struct Color
   uint32_t color;
 };
 
+// refreshed once per turn before AI runs
+struct NearestEnemy
+{
+  float dist = 1e6f;
+};
+
 struct IsPlayer {};
 
 struct Team
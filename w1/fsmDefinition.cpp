@@ -0,0 +1,314 @@
+#include "fsmDefinition.h"
+#include "aiLibrary.h"
+#include "ecsTypes.h"
+#include <algorithm>
+
+size_t FsmBuilder::PredicateKeyHash::operator()(const PredicateKey &key) const
+{
+  const uint64_t operands = (uint64_t(key.op) << 32) | (uint64_t(key.lhs) << 16) | uint64_t(key.rhs);
+  return std::hash<uint64_t>()(operands) ^ (std::hash<float>()(key.param) * size_t(0x9e3779b97f4a7c15ull));
+}
+
+uint16_t FsmBuilder::addPredicate(FsmPredicateOp op, float param, uint16_t lhs, uint16_t rhs)
+{
+  // identical subexpressions share one node, so they're evaluated once
+  auto res = predicateIds.emplace(PredicateKey{op, param, lhs, rhs}, uint16_t(def.predicates.size()));
+  if (res.second)
+    def.predicates.push_back(FsmPredicate{op, param, lhs, rhs});
+  return res.first->second;
+}
+
+uint16_t FsmBuilder::addState(FsmStateKind kind, float param)
+{
+  def.stateKinds.push_back(kind);
+  def.stateParams.push_back(param);
+  return uint16_t(def.stateKinds.size() - 1);
+}
+
+void FsmBuilder::addTransition(uint16_t predicate, uint16_t from, uint16_t to)
+{
+  transitions.push_back(Transition{predicate, from, to});
+}
+
+uint16_t FsmBuilder::enemyAvailable(float dist) { return addPredicate(FPO_ENEMY_AVAILABLE, dist); }
+uint16_t FsmBuilder::enemyReachable() { return addPredicate(FPO_ENEMY_REACHABLE, 0.f); }
+uint16_t FsmBuilder::hitpointsLessThan(float thres) { return addPredicate(FPO_HITPOINTS_LESS_THAN, thres); }
+uint16_t FsmBuilder::negate(uint16_t in) { return addPredicate(FPO_NEGATE, 0.f, in); }
+uint16_t FsmBuilder::both(uint16_t lhs, uint16_t rhs) { return addPredicate(FPO_AND, 0.f, lhs, rhs); }
+
+FsmDefinition FsmBuilder::build() const
+{
+  FsmDefinition res = def;
+  // group transitions by source state, keeping the order they were added in
+  std::vector<Transition> sorted = transitions;
+  std::stable_sort(sorted.begin(), sorted.end(), [](const Transition &lhs, const Transition &rhs)
+  {
+    return lhs.from < rhs.from;
+  });
+  res.transitionStart.assign(res.stateKinds.size() + 1, 0);
+  for (const Transition &trans : sorted)
+  {
+    res.transitionStart[trans.from + 1]++;
+    res.transitionPredicates.push_back(trans.predicate);
+    res.transitionTargets.push_back(trans.to);
+  }
+  for (size_t i = 1; i < res.transitionStart.size(); ++i)
+    res.transitionStart[i] += res.transitionStart[i - 1];
+
+  // operands precede their users, so inputs propagate in one pass
+  std::vector<uint8_t> predicateInputs(res.predicates.size(), 0);
+  for (size_t i = 0; i < res.predicates.size(); ++i)
+  {
+    const FsmPredicate &pred = res.predicates[i];
+    switch (pred.op)
+    {
+      case FPO_ENEMY_AVAILABLE:
+        predicateInputs[i] = FI_ENEMY_DIST;
+        res.enemyDistThresholds.push_back(pred.param);
+        break;
+      case FPO_ENEMY_REACHABLE: break;
+      case FPO_HITPOINTS_LESS_THAN:
+        predicateInputs[i] = FI_HITPOINTS;
+        res.hitpointsThresholds.push_back(pred.param);
+        break;
+      case FPO_NEGATE: predicateInputs[i] = predicateInputs[pred.lhs]; break;
+      case FPO_AND: predicateInputs[i] = predicateInputs[pred.lhs] | predicateInputs[pred.rhs]; break;
+    }
+  }
+  res.stateInputs.assign(res.stateKinds.size(), 0);
+  for (size_t state = 0; state < res.stateKinds.size(); ++state)
+    for (uint16_t i = res.transitionStart[state]; i < res.transitionStart[state + 1]; ++i)
+      res.stateInputs[state] |= predicateInputs[res.transitionPredicates[i]];
+  for (std::vector<float> *thresholds : {&res.enemyDistThresholds, &res.hitpointsThresholds})
+  {
+    std::sort(thresholds->begin(), thresholds->end());
+    thresholds->erase(std::unique(thresholds->begin(), thresholds->end()), thresholds->end());
+  }
+  return res;
+}
+
+struct PredicateContext
+{
+  flecs::world &ecs;
+  flecs::entity entity;
+  const NearestEnemy *nearestEnemy;
+  std::vector<int8_t> &memo; // -1 is not evaluated yet
+};
+
+static bool eval_predicate(const FsmDefinition &def, uint16_t idx, PredicateContext &ctx)
+{
+  if (ctx.memo[idx] >= 0)
+    return ctx.memo[idx] != 0;
+  const FsmPredicate &pred = def.predicates[idx];
+  bool res = false;
+  switch (pred.op)
+  {
+    case FPO_ENEMY_AVAILABLE:
+      res = ctx.nearestEnemy ? ctx.nearestEnemy->dist <= pred.param
+                             : is_enemy_available(ctx.ecs, ctx.entity, pred.param);
+      break;
+    case FPO_ENEMY_REACHABLE: res = false; break;
+    case FPO_HITPOINTS_LESS_THAN: res = is_hitpoints_less_than(ctx.entity, pred.param); break;
+    case FPO_NEGATE: res = !eval_predicate(def, pred.lhs, ctx); break;
+    case FPO_AND: res = eval_predicate(def, pred.lhs, ctx) && eval_predicate(def, pred.rhs, ctx); break;
+  }
+  ctx.memo[idx] = res ? 1 : 0;
+  return res;
+}
+
+static void act_state(const FsmDefinition &def, uint16_t state, flecs::world &ecs, flecs::entity entity)
+{
+  switch (def.stateKinds[state])
+  {
+    case FSK_NOP: break;
+    case FSK_ATTACK_ENEMY: break;
+    case FSK_MOVE_TO_ENEMY: move_to_enemy_act(ecs, entity); break;
+    case FSK_FLEE_FROM_ENEMY: flee_from_enemy_act(ecs, entity); break;
+    case FSK_PATROL: patrol_act(ecs, entity, def.stateParams[state]); break;
+  }
+}
+
+void fsm_act(flecs::world &ecs, flecs::entity entity, FsmInstance &fsm)
+{
+  const FsmDefinition &def = *fsm.def;
+  if (fsm.curState >= def.stateKinds.size())
+  {
+    fsm.curState = 0;
+    return;
+  }
+  static std::vector<int8_t> memo;
+  memo.assign(def.predicates.size(), -1);
+  PredicateContext ctx{ecs, entity, entity.get<NearestEnemy>(), memo};
+  for (uint16_t i = def.transitionStart[fsm.curState]; i < def.transitionStart[fsm.curState + 1]; ++i)
+    if (eval_predicate(def, def.transitionPredicates[i], ctx))
+    {
+      fsm.curState = def.transitionTargets[i];
+      break;
+    }
+  act_state(def, fsm.curState, ecs, entity);
+}
+
+namespace
+{
+  // entities sharing a definition and current state, inputs laid out as columns
+  struct FsmGroup
+  {
+    const FsmDefinition *def;
+    uint16_t state;
+    std::vector<flecs::entity> entities;
+    std::vector<FsmInstance*> fsms;
+    std::vector<float> hitpoints;
+    std::vector<float> enemyDist;
+    std::vector<uint16_t> nextState;
+  };
+}
+
+static void eval_group(FsmGroup &group, std::vector<uint8_t> &values, std::vector<uint8_t> &needed)
+{
+  const FsmDefinition &def = *group.def;
+  const size_t n = group.entities.size();
+  const uint16_t transBegin = def.transitionStart[group.state];
+  const uint16_t transEnd = def.transitionStart[group.state + 1];
+
+  // only predicates reachable from this state's transitions, operands always precede users
+  needed.assign(def.predicates.size(), 0);
+  for (uint16_t i = transBegin; i < transEnd; ++i)
+    needed[def.transitionPredicates[i]] = 1;
+  for (size_t i = def.predicates.size(); i-- > 0;)
+    if (needed[i] && (def.predicates[i].op == FPO_NEGATE || def.predicates[i].op == FPO_AND))
+    {
+      needed[def.predicates[i].lhs] = 1;
+      if (def.predicates[i].op == FPO_AND)
+        needed[def.predicates[i].rhs] = 1;
+    }
+
+  values.resize(def.predicates.size() * n);
+  for (size_t p = 0; p < def.predicates.size(); ++p)
+  {
+    if (!needed[p])
+      continue;
+    const FsmPredicate &pred = def.predicates[p];
+    uint8_t *col = values.data() + p * n;
+    const uint8_t *lhs = values.data() + pred.lhs * n;
+    const uint8_t *rhs = values.data() + pred.rhs * n;
+    switch (pred.op)
+    {
+      case FPO_ENEMY_AVAILABLE:
+        for (size_t i = 0; i < n; ++i)
+          col[i] = group.enemyDist[i] <= pred.param;
+        break;
+      case FPO_ENEMY_REACHABLE:
+        for (size_t i = 0; i < n; ++i)
+          col[i] = 0;
+        break;
+      case FPO_HITPOINTS_LESS_THAN:
+        for (size_t i = 0; i < n; ++i)
+          col[i] = group.hitpoints[i] < pred.param;
+        break;
+      case FPO_NEGATE:
+        for (size_t i = 0; i < n; ++i)
+          col[i] = !lhs[i];
+        break;
+      case FPO_AND:
+        for (size_t i = 0; i < n; ++i)
+          col[i] = lhs[i] & rhs[i];
+        break;
+    }
+  }
+
+  // walk transitions backwards so the first available one wins
+  group.nextState.assign(n, group.state);
+  for (uint16_t t = transEnd; t-- > transBegin;)
+  {
+    const uint8_t *col = values.data() + def.transitionPredicates[t] * n;
+    const uint16_t target = def.transitionTargets[t];
+    for (size_t i = 0; i < n; ++i)
+      group.nextState[i] = col[i] ? target : group.nextState[i];
+  }
+}
+
+// (v <= t) differs for a and b only if min(a, b) <= t < max(a, b)
+static bool crosses_dist_threshold(const std::vector<float> &thresholds, float a, float b)
+{
+  auto it = std::lower_bound(thresholds.begin(), thresholds.end(), std::min(a, b));
+  return it != thresholds.end() && *it < std::max(a, b);
+}
+
+// (v < t) differs for a and b only if min(a, b) < t <= max(a, b)
+static bool crosses_hitpoints_threshold(const std::vector<float> &thresholds, float a, float b)
+{
+  auto it = std::upper_bound(thresholds.begin(), thresholds.end(), std::min(a, b));
+  return it != thresholds.end() && *it <= std::max(a, b);
+}
+
+void fsm_update_batched(flecs::world &ecs)
+{
+  static auto fsmQuery = ecs.query<FsmInstance, const Hitpoints, const NearestEnemy>();
+  static auto allFsmQuery = ecs.query<FsmInstance>();
+  static std::vector<FsmGroup> groups;
+  static std::vector<uint8_t> values;
+  static std::vector<uint8_t> needed;
+  static std::vector<std::pair<flecs::entity, const FsmInstance*>> idle;
+
+  for (FsmGroup &group : groups)
+  {
+    group.entities.clear();
+    group.fsms.clear();
+    group.hitpoints.clear();
+    group.enemyDist.clear();
+  }
+  idle.clear();
+  fsmQuery.each([&](flecs::entity e, FsmInstance &fsm, const Hitpoints &hp, const NearestEnemy &nearest)
+  {
+    if (fsm.curState >= fsm.def->stateKinds.size())
+      fsm.curState = 0;
+    const FsmDefinition &def = *fsm.def;
+    if (crosses_hitpoints_threshold(def.hitpointsThresholds, fsm.seenHitpoints, hp.hitpoints))
+      fsm.pendingInputs |= FI_HITPOINTS;
+    if (crosses_dist_threshold(def.enemyDistThresholds, fsm.seenEnemyDist, nearest.dist))
+      fsm.pendingInputs |= FI_ENEMY_DIST;
+    fsm.seenHitpoints = hp.hitpoints;
+    fsm.seenEnemyDist = nearest.dist;
+    if (!(fsm.pendingInputs & def.stateInputs[fsm.curState]))
+    {
+      idle.emplace_back(e, &fsm);
+      return;
+    }
+    auto it = std::find_if(groups.begin(), groups.end(), [&](const FsmGroup &group)
+    {
+      return group.def == fsm.def && group.state == fsm.curState;
+    });
+    if (it == groups.end())
+    {
+      groups.push_back(FsmGroup{fsm.def, fsm.curState, {}, {}, {}, {}, {}});
+      it = groups.end() - 1;
+    }
+    it->entities.push_back(e);
+    it->fsms.push_back(&fsm);
+    it->hitpoints.push_back(hp.hitpoints);
+    it->enemyDist.push_back(nearest.dist);
+  });
+
+  for (FsmGroup &group : groups)
+  {
+    if (group.entities.empty())
+      continue;
+    eval_group(group, values, needed);
+    for (size_t i = 0; i < group.entities.size(); ++i)
+    {
+      // a new state listens to different predicates, check them all next turn
+      group.fsms[i]->pendingInputs = group.nextState[i] != group.state ? FI_ALL : 0;
+      group.fsms[i]->curState = group.nextState[i];
+      act_state(*group.def, group.nextState[i], ecs, group.entities[i]);
+    }
+  }
+  for (const auto &pair : idle)
+    act_state(*pair.second->def, pair.second->curState, ecs, pair.first);
+
+  // no input columns to batch over, step them one by one
+  allFsmQuery.each([&](flecs::entity e, FsmInstance &fsm)
+  {
+    if (!e.has<Hitpoints>() || !e.has<NearestEnemy>())
+      fsm_act(ecs, e, fsm);
+  });
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <flecs.h>
+
+enum FsmStateKind : uint8_t
+{
+  FSK_NOP = 0,
+  FSK_ATTACK_ENEMY,
+  FSK_MOVE_TO_ENEMY,
+  FSK_FLEE_FROM_ENEMY,
+  FSK_PATROL
+};
+
+enum FsmPredicateOp : uint8_t
+{
+  FPO_ENEMY_AVAILABLE = 0,
+  FPO_ENEMY_REACHABLE,
+  FPO_HITPOINTS_LESS_THAN,
+  FPO_NEGATE,
+  FPO_AND
+};
+
+// what a predicate reads, a state is only re-evaluated when one of its inputs changes
+enum FsmInput : uint8_t
+{
+  FI_HITPOINTS = 1 << 0,
+  FI_ENEMY_DIST = 1 << 1,
+  FI_ALL = FI_HITPOINTS | FI_ENEMY_DIST
+};
+
+struct FsmPredicate
+{
+  FsmPredicateOp op;
+  float param;
+  uint16_t lhs; // operands of negate/and, always earlier in the predicate list
+  uint16_t rhs;
+};
+
+// Immutable state machine shared by all entities running it.
+// Transitions of state i are [transitionStart[i], transitionStart[i + 1]).
+struct FsmDefinition
+{
+  std::vector<FsmStateKind> stateKinds;
+  std::vector<float> stateParams;
+  std::vector<uint16_t> transitionStart;
+  std::vector<uint16_t> transitionPredicates;
+  std::vector<uint16_t> transitionTargets;
+  std::vector<FsmPredicate> predicates; // deduplicated, a DAG in topological order
+  std::vector<uint8_t> stateInputs; // FsmInput mask of each state's outgoing transitions
+  // sorted, an input change that crosses none of them can't change any predicate
+  std::vector<float> enemyDistThresholds;
+  std::vector<float> hitpointsThresholds;
+};
+
+// the only per entity part of a table-driven fsm
+struct FsmInstance
+{
+  const FsmDefinition *def = nullptr;
+  uint16_t curState = 0;
+  uint8_t pendingInputs = FI_ALL;
+  float seenHitpoints = 0.f;
+  float seenEnemyDist = 0.f;
+};
+
+class FsmBuilder
+{
+  struct Transition
+  {
+    uint16_t predicate;
+    uint16_t from;
+    uint16_t to;
+  };
+  // identical subexpressions are hash-consed into one node
+  struct PredicateKey
+  {
+    FsmPredicateOp op;
+    float param;
+    uint16_t lhs;
+    uint16_t rhs;
+
+    bool operator==(const PredicateKey &other) const
+    {
+      return op == other.op && param == other.param && lhs == other.lhs && rhs == other.rhs;
+    }
+  };
+  struct PredicateKeyHash
+  {
+    size_t operator()(const PredicateKey &key) const;
+  };
+  FsmDefinition def;
+  std::vector<Transition> transitions;
+  std::unordered_map<PredicateKey, uint16_t, PredicateKeyHash> predicateIds;
+
+  uint16_t addPredicate(FsmPredicateOp op, float param, uint16_t lhs = 0, uint16_t rhs = 0);
+public:
+  uint16_t addState(FsmStateKind kind, float param = 0.f);
+  void addTransition(uint16_t predicate, uint16_t from, uint16_t to);
+
+  uint16_t enemyAvailable(float dist);
+  uint16_t enemyReachable();
+  uint16_t hitpointsLessThan(float thres);
+  uint16_t negate(uint16_t in);
+  uint16_t both(uint16_t lhs, uint16_t rhs);
+
+  FsmDefinition build() const;
+};
+
+void fsm_act(flecs::world &ecs, flecs::entity entity, FsmInstance &fsm);
+// steps every fsm entity with Hitpoints and NearestEnemy, evaluating predicates
+// column-wise over groups of entities that share a definition and current state;
+// entities whose watched inputs didn't change since the last check only act.
+// Entities missing either component go through fsm_act instead.
+void fsm_update_batched(flecs::world &ecs);
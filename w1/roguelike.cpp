@@ -3,49 +3,70 @@
 #include <debugdraw/debugdraw.h>
 #include "stateMachine.h"
 #include "aiLibrary.h"
+#include "fsmDefinition.h"
+#include "staticStateMachine.h"
 #include "app.h"
+#include "math.h"
+
+#include <algorithm>
+#include <cmath>
 
 //for scancodes
 #include <GLFW/glfw3.h>
 
-static void add_patrol_attack_flee_sm(flecs::entity entity)
+static const FsmDefinition &patrol_attack_flee_fsm()
 {
-  entity.get([](StateMachine &sm)
+  static const FsmDefinition def = []()
   {
-    int patrol = sm.addState(create_patrol_state(3.f));
-    int moveToEnemy = sm.addState(create_move_to_enemy_state());
-    int fleeFromEnemy = sm.addState(create_flee_from_enemy_state());
+    FsmBuilder fsm;
+    uint16_t patrol = fsm.addState(FSK_PATROL, 3.f);
+    uint16_t moveToEnemy = fsm.addState(FSK_MOVE_TO_ENEMY);
+    uint16_t fleeFromEnemy = fsm.addState(FSK_FLEE_FROM_ENEMY);
 
-    sm.addTransition(create_enemy_available_transition(3.f), patrol, moveToEnemy);
-    sm.addTransition(create_negate_transition(create_enemy_available_transition(5.f)), moveToEnemy, patrol);
+    fsm.addTransition(fsm.enemyAvailable(3.f), patrol, moveToEnemy);
+    fsm.addTransition(fsm.negate(fsm.enemyAvailable(5.f)), moveToEnemy, patrol);
 
-    sm.addTransition(create_and_transition(create_hitpoints_less_than_transition(60.f), create_enemy_available_transition(5.f)),
-                     moveToEnemy, fleeFromEnemy);
-    sm.addTransition(create_and_transition(create_hitpoints_less_than_transition(60.f), create_enemy_available_transition(3.f)),
-                     patrol, fleeFromEnemy);
+    fsm.addTransition(fsm.both(fsm.hitpointsLessThan(60.f), fsm.enemyAvailable(5.f)),
+                      moveToEnemy, fleeFromEnemy);
+    fsm.addTransition(fsm.both(fsm.hitpointsLessThan(60.f), fsm.enemyAvailable(3.f)),
+                      patrol, fleeFromEnemy);
 
-    sm.addTransition(create_negate_transition(create_enemy_available_transition(7.f)), fleeFromEnemy, patrol);
-  });
+    fsm.addTransition(fsm.negate(fsm.enemyAvailable(7.f)), fleeFromEnemy, patrol);
+    return fsm.build();
+  }();
+  return def;
 }
 
-static void add_patrol_flee_sm(flecs::entity entity)
+using PatrolFleeSm = sfsm::StateMachine<
+  sfsm::TransitionTable<
+    sfsm::Transition<sfsm::Patrol<3>, sfsm::EnemyAvailable<3>, sfsm::FleeFromEnemy>,
+    sfsm::Transition<sfsm::FleeFromEnemy, sfsm::Not<sfsm::EnemyAvailable<5>>, sfsm::Patrol<3>>>,
+  sfsm::Patrol<3>, sfsm::FleeFromEnemy>;
+
+static const FsmDefinition &attack_fsm()
 {
-  entity.get([](StateMachine &sm)
+  static const FsmDefinition def = []()
   {
-    int patrol = sm.addState(create_patrol_state(3.f));
-    int fleeFromEnemy = sm.addState(create_flee_from_enemy_state());
+    FsmBuilder fsm;
+    fsm.addState(FSK_MOVE_TO_ENEMY);
+    return fsm.build();
+  }();
+  return def;
+}
 
-    sm.addTransition(create_enemy_available_transition(3.f), patrol, fleeFromEnemy);
-    sm.addTransition(create_negate_transition(create_enemy_available_transition(5.f)), fleeFromEnemy, patrol);
-  });
+static void add_patrol_attack_flee_sm(flecs::entity entity)
+{
+  entity.set(FsmInstance{&patrol_attack_flee_fsm(), 0});
+}
+
+static void add_patrol_flee_sm(flecs::entity entity)
+{
+  entity.set(PatrolFleeSm{});
 }
 
 static void add_attack_sm(flecs::entity entity)
 {
-  entity.get([](StateMachine &sm)
-  {
-    sm.addState(create_move_to_enemy_state());
-  });
+  entity.set(FsmInstance{&attack_fsm(), 0});
 }
 
 static flecs::entity create_monster(flecs::world &ecs, int x, int y, uint32_t color)
@@ -57,8 +78,8 @@ static flecs::entity create_monster(flecs::world &ecs, int x, int y, uint32_t co
     .set(Hitpoints{100.f})
     .set(Action{EA_NOP})
     .set(Color{color})
-    .set(StateMachine{})
     .set(Team{1})
+    .set(NearestEnemy{})
     .set(NumActions{1, 0})
     .set(MeleeDamage{20.f});
 }
@@ -255,6 +276,23 @@ static void process_actions(flecs::world &ecs)
   });
 }
 
+// sensors
+static void update_nearest_enemies(flecs::world &ecs)
+{
+  static auto nearestEnemyQuery = ecs.query<NearestEnemy, const Position, const Team>();
+  static auto enemiesQuery = ecs.query<const Position, const Team>();
+  nearestEnemyQuery.each([&](NearestEnemy &nearest, const Position &pos, const Team &t)
+  {
+    nearest.dist = 1e6f;
+    enemiesQuery.each([&](const Position &epos, const Team &et)
+    {
+      if (t.team == et.team)
+        return;
+      nearest.dist = std::min(nearest.dist, dist(epos, pos));
+    });
+  });
+}
+
 void process_turn(flecs::world &ecs)
 {
   static auto stateMachineAct = ecs.query<StateMachine>();
@@ -263,12 +301,15 @@ void process_turn(flecs::world &ecs)
     if (upd_player_actions_count(ecs))
     {
       // Plan action for NPCs
+      update_nearest_enemies(ecs);
       ecs.defer([&]
       {
         stateMachineAct.each([&](flecs::entity e, StateMachine &sm)
         {
           sm.act(0.f, ecs, e);
         });
+        fsm_update_batched(ecs);
+        sfsm::act_all<PatrolFleeSm>(ecs, 0.f);
       });
     }
     process_actions(ecs);
@@ -1,4 +1,5 @@
 #include "stateMachine.h"
+#include <utility>
 
 StateMachine::~StateMachine()
 {
@@ -11,6 +12,15 @@ StateMachine::~StateMachine()
   transitions.clear();
 }
 
+StateMachine &StateMachine::operator=(StateMachine &&sm)
+{
+  // swap so that whatever we held gets freed by sm
+  std::swap(curStateIdx, sm.curStateIdx);
+  states.swap(sm.states);
+  transitions.swap(sm.transitions);
+  return *this;
+}
+
 void StateMachine::act(float dt, flecs::world &ecs, flecs::entity entity)
 {
   if (curStateIdx < states.size())
@@ -24,13 +24,14 @@ class StateMachine
   std::vector<std::vector<std::pair<StateTransition*, int>>> transitions;
 public:
   StateMachine() = default;
-  StateMachine(const StateMachine &sm) = default;
+  // owns raw states and transitions, so copying would double free them
+  StateMachine(const StateMachine &sm) = delete;
   StateMachine(StateMachine &&sm) = default;
 
   ~StateMachine();
 
-  StateMachine &operator=(const StateMachine &sm) = default;
-  StateMachine &operator=(StateMachine &&sm) = default;
+  StateMachine &operator=(const StateMachine &sm) = delete;
+  StateMachine &operator=(StateMachine &&sm);
 
 
   void act(float dt, flecs::world &ecs, flecs::entity entity);
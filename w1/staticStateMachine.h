@@ -0,0 +1,139 @@
+#pragma once
+#include <type_traits>
+#include <variant>
+#include <flecs.h>
+#include "ecsTypes.h"
+#include "aiLibrary.h"
+
+// Compile-time state machine for archetypes fixed at build time: states are
+// types in a std::variant and transitions are a type list of
+// (From, Predicate, To), so there's no heap allocation or virtual dispatch.
+namespace sfsm
+{
+  template<typename From, typename Predicate, typename To>
+  struct Transition
+  {
+    using from = From;
+    using predicate = Predicate;
+    using to = To;
+  };
+
+  template<typename... Transitions>
+  struct TransitionTable {};
+
+  // predicates
+  template<int Dist>
+  struct EnemyAvailable
+  {
+    bool operator()(flecs::world &ecs, flecs::entity entity) const
+    {
+      if (const NearestEnemy *nearest = entity.get<NearestEnemy>())
+        return nearest->dist <= float(Dist);
+      return is_enemy_available(ecs, entity, float(Dist));
+    }
+  };
+
+  template<int Thres>
+  struct HitpointsLessThan
+  {
+    bool operator()(flecs::world &, flecs::entity entity) const
+    {
+      const Hitpoints *hp = entity.get<Hitpoints>();
+      return hp && hp->hitpoints < float(Thres);
+    }
+  };
+
+  template<typename P>
+  struct Not
+  {
+    bool operator()(flecs::world &ecs, flecs::entity entity) const { return !P{}(ecs, entity); }
+  };
+
+  template<typename Lhs, typename Rhs>
+  struct And
+  {
+    bool operator()(flecs::world &ecs, flecs::entity entity) const
+    {
+      return Lhs{}(ecs, entity) && Rhs{}(ecs, entity);
+    }
+  };
+
+  // states
+  struct Nop
+  {
+    void act(float, flecs::world &, flecs::entity) const {}
+  };
+
+  struct MoveToEnemy
+  {
+    void act(float, flecs::world &ecs, flecs::entity entity) const { move_to_enemy_act(ecs, entity); }
+  };
+
+  struct FleeFromEnemy
+  {
+    void act(float, flecs::world &ecs, flecs::entity entity) const { flee_from_enemy_act(ecs, entity); }
+  };
+
+  template<int Dist>
+  struct Patrol
+  {
+    void act(float, flecs::world &ecs, flecs::entity entity) const { patrol_act(ecs, entity, float(Dist)); }
+  };
+
+  template<typename T, typename... Ts>
+  constexpr bool is_one_of = (std::is_same_v<T, Ts> || ...);
+
+  template<typename Table, typename... States>
+  class StateMachine;
+
+  // first state in the list is the initial one
+  template<typename... Transitions, typename... States>
+  class StateMachine<TransitionTable<Transitions...>, States...>
+  {
+    static_assert(((is_one_of<typename Transitions::from, States...> &&
+                    is_one_of<typename Transitions::to, States...>) && ...),
+                  "transition refers to a state which is not in the state list");
+
+    std::variant<States...> state;
+
+    template<typename Cur, typename Trans>
+    bool tryTransition(flecs::world &ecs, flecs::entity entity)
+    {
+      if constexpr (std::is_same_v<typename Trans::from, Cur>)
+      {
+        if (typename Trans::predicate{}(ecs, entity))
+        {
+          state.template emplace<typename Trans::to>();
+          return true;
+        }
+      }
+      return false;
+    }
+
+  public:
+    void act(float dt, flecs::world &ecs, flecs::entity entity)
+    {
+      std::visit([&](const auto &cur)
+      {
+        using Cur = std::decay_t<decltype(cur)>;
+        // stops at the first available transition, in declaration order
+        (tryTransition<Cur, Transitions>(ecs, entity) || ...);
+      }, state);
+      std::visit([&](const auto &cur) { cur.act(dt, ecs, entity); }, state);
+    }
+
+    template<typename S>
+    bool isIn() const { return std::holds_alternative<S>(state); }
+  };
+
+  // steps every entity with this machine as a component
+  template<typename Sm>
+  void act_all(flecs::world &ecs, float dt)
+  {
+    static auto query = ecs.query<Sm>();
+    query.each([&](flecs::entity e, Sm &sm)
+    {
+      sm.act(dt, ecs, e);
+    });
+  }
+}
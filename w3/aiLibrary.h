@@ -31,3 +31,11 @@ BehNode *flee(flecs::entity entity, const char *bb_name);
 BehNode *patrol(flecs::entity entity, float patrol_dist, const char *bb_name);
 BehNode *patch_up(float thres);
 
+// leaf logic shared by node based and compiled trees
+BehResult move_to_entity_update(flecs::entity entity, flecs::entity target);
+BehResult is_low_hp_update(flecs::entity entity, float threshold);
+BehResult find_enemy_update(flecs::world &ecs, flecs::entity entity, float distance, flecs::entity &enemy_out);
+BehResult flee_update(flecs::entity entity, flecs::entity target);
+BehResult patrol_update(flecs::entity entity, const Position &patrol_pos, float patrol_dist);
+BehResult patch_up_update(flecs::entity entity, float threshold);
+
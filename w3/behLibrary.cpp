@@ -4,7 +4,7 @@
 #include "math.h"
 #include "raylib.h"
 #include "blackboard.h"
-#include <algorithm>
+#include "staticUtilitySelector.h"
 
 struct CompoundNode : public BehNode
 {
@@ -58,26 +58,122 @@ struct UtilitySelector : public BehNode
 
   BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
-    std::vector<std::pair<float, size_t>> utilityScores;
+    std::array<float, maxUtilityChildren> scores;
     for (size_t i = 0; i < utilityNodes.size(); ++i)
+      scores[i] = utilityNodes[i].second(bb);
+    return select_best_first(scores.data(), utilityNodes.size(), [&](size_t i)
     {
-      const float utilityScore = utilityNodes[i].second(bb);
-      utilityScores.push_back(std::make_pair(utilityScore, i));
+      return utilityNodes[i].first->update(ecs, entity, bb);
+    });
+  }
+};
+
+BehResult move_to_entity_update(flecs::entity entity, flecs::entity target)
+{
+  BehResult res = BEH_RUNNING;
+  entity.set([&](Action &a, const Position &pos)
+  {
+    if (!target.is_alive())
+    {
+      res = BEH_FAIL;
+      return;
     }
-    std::sort(utilityScores.begin(), utilityScores.end(), [](auto &lhs, auto &rhs)
+    target.get([&](const Position &target_pos)
     {
-      return lhs.first > rhs.first;
+      if (pos != target_pos)
+      {
+        a.action = move_towards(pos, target_pos);
+        res = BEH_RUNNING;
+      }
+      else
+        res = BEH_SUCCESS;
     });
-    for (const std::pair<float, size_t> &node : utilityScores)
+  });
+  return res;
+}
+
+BehResult is_low_hp_update(flecs::entity entity, float threshold)
+{
+  BehResult res = BEH_SUCCESS;
+  entity.get([&](const Hitpoints &hp)
+  {
+    res = hp.hitpoints < threshold ? BEH_SUCCESS : BEH_FAIL;
+  });
+  return res;
+}
+
+BehResult find_enemy_update(flecs::world &ecs, flecs::entity entity, float distance, flecs::entity &enemy_out)
+{
+  BehResult res = BEH_FAIL;
+  static auto enemiesQuery = ecs.query<const Position, const Team>();
+  entity.set([&](const Position &pos, const Team &t)
+  {
+    flecs::entity closestEnemy;
+    float closestDist = FLT_MAX;
+    Position closestPos;
+    enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
     {
-      size_t nodeIdx = node.second;
-      BehResult res = utilityNodes[nodeIdx].first->update(ecs, entity, bb);
-      if (res != BEH_FAIL)
-        return res;
+      if (t.team == et.team)
+        return;
+      float curDist = dist(epos, pos);
+      if (curDist < closestDist)
+      {
+        closestDist = curDist;
+        closestPos = epos;
+        closestEnemy = enemy;
+      }
+    });
+    if (ecs.is_valid(closestEnemy) && closestDist <= distance)
+    {
+      enemy_out = closestEnemy;
+      res = BEH_SUCCESS;
     }
-    return BEH_FAIL;
-  }
-};
+  });
+  return res;
+}
+
+BehResult flee_update(flecs::entity entity, flecs::entity target)
+{
+  BehResult res = BEH_RUNNING;
+  entity.set([&](Action &a, const Position &pos)
+  {
+    if (!target.is_alive())
+    {
+      res = BEH_FAIL;
+      return;
+    }
+    target.get([&](const Position &target_pos)
+    {
+      a.action = inverse_move(move_towards(pos, target_pos));
+    });
+  });
+  return res;
+}
+
+BehResult patrol_update(flecs::entity entity, const Position &patrol_pos, float patrol_dist)
+{
+  entity.set([&](Action &a, const Position &pos)
+  {
+    if (dist(pos, patrol_pos) > patrol_dist)
+      a.action = move_towards(pos, patrol_pos);
+    else
+      a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1); // do a random walk
+  });
+  return BEH_RUNNING;
+}
+
+BehResult patch_up_update(flecs::entity entity, float threshold)
+{
+  BehResult res = BEH_SUCCESS;
+  entity.set([&](Action &a, Hitpoints &hp)
+  {
+    if (hp.hitpoints >= threshold)
+      return;
+    res = BEH_RUNNING;
+    a.action = EA_HEAL_SELF;
+  });
+  return res;
+}
 
 struct MoveToEntity : public BehNode
 {
@@ -89,27 +185,7 @@ struct MoveToEntity : public BehNode
 
   BehResult update(flecs::world &, flecs::entity entity, Blackboard &bb) override
   {
-    BehResult res = BEH_RUNNING;
-    entity.set([&](Action &a, const Position &pos)
-    {
-      flecs::entity targetEntity = bb.get<flecs::entity>(entityBb);
-      if (!targetEntity.is_alive())
-      {
-        res = BEH_FAIL;
-        return;
-      }
-      targetEntity.get([&](const Position &target_pos)
-      {
-        if (pos != target_pos)
-        {
-          a.action = move_towards(pos, target_pos);
-          res = BEH_RUNNING;
-        }
-        else
-          res = BEH_SUCCESS;
-      });
-    });
-    return res;
+    return move_to_entity_update(entity, bb.get<flecs::entity>(entityBb));
   }
 };
 
@@ -120,12 +196,7 @@ struct IsLowHp : public BehNode
 
   BehResult update(flecs::world &, flecs::entity entity, Blackboard &) override
   {
-    BehResult res = BEH_SUCCESS;
-    entity.get([&](const Hitpoints &hp)
-    {
-      res = hp.hitpoints < threshold ? BEH_SUCCESS : BEH_FAIL;
-    });
-    return res;
+    return is_low_hp_update(entity, threshold);
   }
 };
 
@@ -139,31 +210,10 @@ struct FindEnemy : public BehNode
   }
   BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
-    BehResult res = BEH_FAIL;
-    static auto enemiesQuery = ecs.query<const Position, const Team>();
-    entity.set([&](const Position &pos, const Team &t)
-    {
-      flecs::entity closestEnemy;
-      float closestDist = FLT_MAX;
-      Position closestPos;
-      enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
-      {
-        if (t.team == et.team)
-          return;
-        float curDist = dist(epos, pos);
-        if (curDist < closestDist)
-        {
-          closestDist = curDist;
-          closestPos = epos;
-          closestEnemy = enemy;
-        }
-      });
-      if (ecs.is_valid(closestEnemy) && closestDist <= distance)
-      {
-        bb.set<flecs::entity>(entityBb, closestEnemy);
-        res = BEH_SUCCESS;
-      }
-    });
+    flecs::entity enemy;
+    BehResult res = find_enemy_update(ecs, entity, distance, enemy);
+    if (res == BEH_SUCCESS)
+      bb.set<flecs::entity>(entityBb, enemy);
     return res;
   }
 };
@@ -178,21 +228,7 @@ struct Flee : public BehNode
 
   BehResult update(flecs::world &, flecs::entity entity, Blackboard &bb) override
   {
-    BehResult res = BEH_RUNNING;
-    entity.set([&](Action &a, const Position &pos)
-    {
-      flecs::entity targetEntity = bb.get<flecs::entity>(entityBb);
-      if (!targetEntity.is_alive())
-      {
-        res = BEH_FAIL;
-        return;
-      }
-      targetEntity.get([&](const Position &target_pos)
-      {
-        a.action = inverse_move(move_towards(pos, target_pos));
-      });
-    });
-    return res;
+    return flee_update(entity, bb.get<flecs::entity>(entityBb));
   }
 };
 
@@ -212,16 +248,7 @@ struct Patrol : public BehNode
 
   BehResult update(flecs::world &, flecs::entity entity, Blackboard &bb) override
   {
-    BehResult res = BEH_RUNNING;
-    entity.set([&](Action &a, const Position &pos)
-    {
-      Position patrolPos = bb.get<Position>(pposBb);
-      if (dist(pos, patrolPos) > patrolDist)
-        a.action = move_towards(pos, patrolPos);
-      else
-        a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1); // do a random walk
-    });
-    return res;
+    return patrol_update(entity, bb.get<Position>(pposBb), patrolDist);
   }
 };
 
@@ -232,15 +259,7 @@ struct PatchUp : public BehNode
 
   BehResult update(flecs::world &, flecs::entity entity, Blackboard &) override
   {
-    BehResult res = BEH_SUCCESS;
-    entity.set([&](Action &a, Hitpoints &hp)
-    {
-      if (hp.hitpoints >= hpThreshold)
-        return;
-      res = BEH_RUNNING;
-      a.action = EA_HEAL_SELF;
-    });
-    return res;
+    return patch_up_update(entity, hpThreshold);
   }
 };
 
@@ -264,8 +283,13 @@ BehNode *selector(const std::vector<BehNode*> &nodes)
 
 BehNode *utility_selector(const std::vector<std::pair<BehNode*, utility_function>> &nodes)
 {
+  assert(nodes.size() <= maxUtilityChildren);
   UtilitySelector *usel = new UtilitySelector;
-  usel->utilityNodes = std::move(nodes);
+  // scores live in a fixed array, extra children are dropped in release builds too
+  const size_t count = std::min(nodes.size(), maxUtilityChildren);
+  usel->utilityNodes.assign(nodes.begin(), nodes.begin() + ptrdiff_t(count));
+  for (size_t i = count; i < nodes.size(); ++i)
+    delete nodes[i].first;
   return usel;
 }
 
@@ -0,0 +1,362 @@
+#include "compiledBehTree.h"
+#include "staticUtilitySelector.h"
+#include <algorithm>
+#include <cassert>
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::push(CompiledBehNodeType type, float param, uint16_t slot)
+{
+  CompiledBehNode node;
+  node.type = type;
+  node.param = param;
+  node.slot = slot;
+  tree.nodes.push_back(node);
+  tree.nodes.back().subtreeEnd = uint16_t(tree.nodes.size());
+  return *this;
+}
+
+uint16_t CompiledBehTreeBuilder::entitySlot(const char *bb_name)
+{
+  auto res = entitySlots.emplace(bb_name, tree.numEntitySlots);
+  if (res.second)
+    tree.numEntitySlots++;
+  return res.first->second;
+}
+
+uint16_t CompiledBehTreeBuilder::positionSlot(const char *bb_name)
+{
+  auto res = positionSlots.emplace(bb_name, tree.numPositionSlots);
+  if (res.second)
+    tree.numPositionSlots++;
+  return res.first->second;
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::open(CompiledBehNodeType type, uint16_t slot)
+{
+  openNodes.push_back({tree.nodes.size(), {}});
+  return push(type, 0.f, slot);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::sequence()
+{
+  return open(CBN_SEQUENCE);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::selector()
+{
+  return open(CBN_SELECTOR);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::utilitySelector()
+{
+  return open(CBN_UTILITY_SELECTOR);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::curveUtilitySelector()
+{
+  return open(CBN_CURVE_UTILITY_SELECTOR);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::memSequence()
+{
+  return open(CBN_MEM_SEQUENCE, tree.numRunningSlots++);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::memSelector()
+{
+  return open(CBN_MEM_SELECTOR, tree.numRunningSlots++);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::reactiveSequence()
+{
+  return open(CBN_REACTIVE_SEQUENCE, tree.numRunningSlots++);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::reactiveSelector()
+{
+  return open(CBN_REACTIVE_SELECTOR, tree.numRunningSlots++);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::utility(compiled_utility_function func)
+{
+  assert(!openNodes.empty() && tree.nodes[openNodes.back().idx].type == CBN_UTILITY_SELECTOR);
+  assert(openNodes.back().utilities.size() < maxUtilityChildren);
+  openNodes.back().utilities.push_back(std::move(func));
+  return *this;
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::option(float bias)
+{
+  assert(!openNodes.empty() && tree.nodes[openNodes.back().idx].type == CBN_CURVE_UTILITY_SELECTOR);
+  assert(openNodes.back().optionBiases.size() < maxUtilityChildren);
+  openNodes.back().optionBiases.push_back(bias);
+  return *this;
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::curve(ResponseCurve curve)
+{
+  assert(!openNodes.empty() && !openNodes.back().optionBiases.empty());
+  openNodes.back().curves.emplace_back(uint16_t(openNodes.back().optionBiases.size() - 1), std::move(curve));
+  return *this;
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::end()
+{
+  assert(!openNodes.empty());
+  OpenNode &open = openNodes.back();
+  CompiledBehNode &node = tree.nodes[open.idx];
+  node.subtreeEnd = uint16_t(tree.nodes.size());
+  if (node.type == CBN_UTILITY_SELECTOR)
+  {
+    // nested selectors are closed first, so utilities of one selector stay contiguous
+    node.slot = uint16_t(tree.utilities.size());
+    for (compiled_utility_function &func : open.utilities)
+      tree.utilities.push_back(std::move(func));
+  }
+  else if (node.type == CBN_CURVE_UTILITY_SELECTOR)
+  {
+    node.slot = uint16_t(tree.optionBiases.size());
+    tree.optionBiases.insert(tree.optionBiases.end(), open.optionBiases.begin(), open.optionBiases.end());
+    for (std::pair<uint16_t, ResponseCurve> &curve : open.curves)
+    {
+      tree.curveOptions.push_back(uint16_t(node.slot + curve.first));
+      tree.curves.push_back(std::move(curve.second));
+    }
+  }
+  openNodes.pop_back();
+  return *this;
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::moveToEntity(const char *bb_name)
+{
+  return push(CBN_MOVE_TO_ENTITY, 0.f, entitySlot(bb_name));
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::isLowHp(float thres)
+{
+  return push(CBN_IS_LOW_HP, thres);
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::findEnemy(float dist, const char *bb_name)
+{
+  return push(CBN_FIND_ENEMY, dist, entitySlot(bb_name));
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::flee(const char *bb_name)
+{
+  return push(CBN_FLEE, 0.f, entitySlot(bb_name));
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::patrol(float patrol_dist, const char *bb_name)
+{
+  return push(CBN_PATROL, patrol_dist, positionSlot(bb_name));
+}
+
+CompiledBehTreeBuilder &CompiledBehTreeBuilder::patchUp(float thres)
+{
+  return push(CBN_PATCH_UP, thres);
+}
+
+uint16_t CompiledBehTreeBuilder::input(const char *bb_name)
+{
+  auto res = inputs.emplace(bb_name, uint16_t(tree.inputNames.size()));
+  if (res.second)
+    tree.inputNames.push_back(bb_name);
+  return res.first->second;
+}
+
+CompiledBehTree CompiledBehTreeBuilder::build()
+{
+  assert(openNodes.empty());
+  return std::move(tree);
+}
+
+BehTreeInstance create_beh_tree_instance(const CompiledBehTree &tree, Blackboard &bb, const Position &spawn_pos)
+{
+  BehTreeInstance inst;
+  inst.tree = &tree;
+  inst.entities.resize(tree.numEntitySlots);
+  // patrol around the spawn point
+  inst.positions.resize(tree.numPositionSlots, spawn_pos);
+  inst.running.resize(tree.numRunningSlots);
+  inst.optionScores = tree.optionBiases;
+  for (const std::string &name : tree.inputNames)
+    inst.inputSlots.push_back(bb.regName<float>(name));
+  return inst;
+}
+
+struct CompiledBehTreeRunner
+{
+  flecs::world &ecs;
+  flecs::entity entity;
+  const CompiledBehTree &tree;
+  BehTreeInstance &inst;
+  BehInputs inputs;
+
+  // sequence and selector only differ in which result moves on to the next child
+  BehResult tickMemory(const CompiledBehNode &node, size_t firstChild, BehResult continueRes)
+  {
+    BehRunningChild &running = inst.running[node.slot];
+    size_t child = firstChild;
+    if (running.child != 0 && running.tick + 1 == inst.tick)
+      child = running.child;
+    for (; child < node.subtreeEnd; child = tree.nodes[child].subtreeEnd)
+    {
+      BehResult res = tick(child);
+      if (res == BEH_RUNNING)
+        running = {uint16_t(child), inst.tick};
+      if (res != continueRes)
+        return res;
+    }
+    return continueRes;
+  }
+
+  BehResult tickReactive(size_t idx, const CompiledBehNode &node, BehResult continueRes)
+  {
+    // failed abort condition drops whatever was running
+    if (tick(idx + 1) == BEH_FAIL)
+      return BEH_FAIL;
+    return tickMemory(node, tree.nodes[idx + 1].subtreeEnd, continueRes);
+  }
+
+  BehResult tick(size_t idx)
+  {
+    const CompiledBehNode &node = tree.nodes[idx];
+    switch (node.type)
+    {
+    case CBN_SEQUENCE:
+      for (size_t child = idx + 1; child < node.subtreeEnd; child = tree.nodes[child].subtreeEnd)
+      {
+        BehResult res = tick(child);
+        if (res != BEH_SUCCESS)
+          return res;
+      }
+      return BEH_SUCCESS;
+    case CBN_SELECTOR:
+      for (size_t child = idx + 1; child < node.subtreeEnd; child = tree.nodes[child].subtreeEnd)
+      {
+        BehResult res = tick(child);
+        if (res != BEH_FAIL)
+          return res;
+      }
+      return BEH_FAIL;
+    case CBN_UTILITY_SELECTOR:
+    {
+      std::array<float, maxUtilityChildren> scores;
+      std::array<uint16_t, maxUtilityChildren> children;
+      size_t count = 0;
+      // children past maxUtilityChildren are never selected
+      for (size_t child = idx + 1; child < node.subtreeEnd && count < maxUtilityChildren;
+           child = tree.nodes[child].subtreeEnd, ++count)
+      {
+        scores[count] = tree.utilities[node.slot + count](inputs);
+        children[count] = uint16_t(child);
+      }
+      return select_best_first(scores.data(), count, [&](size_t i)
+      {
+        return tick(children[i]);
+      });
+    }
+    case CBN_CURVE_UTILITY_SELECTOR:
+    {
+      std::array<uint16_t, maxUtilityChildren> children;
+      size_t count = 0;
+      for (size_t child = idx + 1; child < node.subtreeEnd && count < maxUtilityChildren;
+           child = tree.nodes[child].subtreeEnd)
+        children[count++] = uint16_t(child);
+      // scores are already there, so this only takes the argmax unless it fails
+      return select_best_first(inst.optionScores.data() + node.slot, count, [&](size_t i)
+      {
+        return tick(children[i]);
+      });
+    }
+    case CBN_MEM_SEQUENCE:
+      return tickMemory(node, idx + 1, BEH_SUCCESS);
+    case CBN_MEM_SELECTOR:
+      return tickMemory(node, idx + 1, BEH_FAIL);
+    case CBN_REACTIVE_SEQUENCE:
+      return tickReactive(idx, node, BEH_SUCCESS);
+    case CBN_REACTIVE_SELECTOR:
+      return tickReactive(idx, node, BEH_FAIL);
+    case CBN_MOVE_TO_ENTITY:
+      return move_to_entity_update(entity, inst.entities[node.slot]);
+    case CBN_IS_LOW_HP:
+      return is_low_hp_update(entity, node.param);
+    case CBN_FIND_ENEMY:
+      return find_enemy_update(ecs, entity, node.param, inst.entities[node.slot]);
+    case CBN_FLEE:
+      return flee_update(entity, inst.entities[node.slot]);
+    case CBN_PATROL:
+      return patrol_update(entity, inst.positions[node.slot], node.param);
+    case CBN_PATCH_UP:
+      return patch_up_update(entity, node.param);
+    }
+    return BEH_FAIL;
+  }
+};
+
+void score_beh_tree_utilities(flecs::world &ecs)
+{
+  static auto instancesQuery = ecs.query<BehTreeInstance, const Blackboard>();
+  // called outside of defer, so this is the singleton itself and buffers keep their capacity
+  BehUtilityBatches &ub = *ecs.get_mut<BehUtilityBatches>();
+  for (BehUtilityBatch &batch : ub.batches)
+  {
+    batch.instances.clear();
+    batch.blackboards.clear();
+  }
+  instancesQuery.each([&](BehTreeInstance &inst, const Blackboard &bb)
+  {
+    if (!inst.tree || inst.tree->optionBiases.empty())
+      return;
+    // only a handful of archetypes, a linear search is enough
+    auto it = std::find_if(ub.batches.begin(), ub.batches.end(), [&](const BehUtilityBatch &batch)
+    {
+      return batch.tree == inst.tree;
+    });
+    if (it == ub.batches.end())
+    {
+      ub.batches.push_back(BehUtilityBatch{inst.tree, {}, {}});
+      it = ub.batches.end() - 1;
+    }
+    it->instances.push_back(&inst);
+    it->blackboards.push_back(&bb);
+  });
+
+  // columns are [input][entity] and [option][entity]
+  std::vector<float> &inputs = ub.inputs;
+  std::vector<float> &scores = ub.scores;
+  for (const BehUtilityBatch &batch : ub.batches)
+  {
+    const CompiledBehTree *tree = batch.tree;
+    const size_t count = batch.instances.size();
+    if (count == 0)
+      continue;
+    inputs.resize(tree->inputNames.size() * count);
+    for (size_t input = 0; input < tree->inputNames.size(); ++input)
+      for (size_t i = 0; i < count; ++i)
+        inputs[input * count + i] = batch.blackboards[i]->get<float>(batch.instances[i]->inputSlots[input]);
+
+    scores.resize(tree->optionBiases.size() * count);
+    for (size_t option = 0; option < tree->optionBiases.size(); ++option)
+      std::fill_n(scores.data() + option * count, count, tree->optionBiases[option]);
+    for (size_t c = 0; c < tree->curves.size(); ++c)
+    {
+      const ResponseCurve &curve = tree->curves[c];
+      accumulate_response_curve(curve, inputs.data() + curve.input * count,
+                                scores.data() + tree->curveOptions[c] * count, count);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+      for (size_t option = 0; option < tree->optionBiases.size(); ++option)
+        batch.instances[i]->optionScores[option] = scores[option * count + i];
+  }
+}
+
+BehResult update_compiled_beh_tree(flecs::world &ecs, flecs::entity entity, BehTreeInstance &inst, Blackboard &bb)
+{
+  if (!inst.tree || inst.tree->nodes.empty())
+    return BEH_FAIL;
+  inst.tick++;
+  CompiledBehTreeRunner runner{ecs, entity, *inst.tree, inst, BehInputs{bb, inst.inputSlots.data()}};
+  return runner.tick(0);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <flecs.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "aiLibrary.h"
+#include "responseCurves.h"
+
+enum CompiledBehNodeType : uint8_t
+{
+  CBN_SEQUENCE,
+  CBN_SELECTOR,
+  CBN_UTILITY_SELECTOR,
+  CBN_CURVE_UTILITY_SELECTOR,
+  CBN_MEM_SEQUENCE,
+  CBN_MEM_SELECTOR,
+  CBN_REACTIVE_SEQUENCE,
+  CBN_REACTIVE_SELECTOR,
+  CBN_MOVE_TO_ENTITY,
+  CBN_IS_LOW_HP,
+  CBN_FIND_ENEMY,
+  CBN_FLEE,
+  CBN_PATROL,
+  CBN_PATCH_UP
+};
+
+// Nodes are stored in pre-order, so children of node i live in [i + 1, subtreeEnd)
+// and are walked by jumping from one child's subtreeEnd to the next.
+struct CompiledBehNode
+{
+  CompiledBehNodeType type;
+  uint16_t subtreeEnd = 0;
+  uint16_t slot = 0; // entity/position slot of the leaf, first utility/option of a utility selector,
+                     // running slot of a memory/reactive compound
+  float param = 0.f;
+};
+
+// blackboard floats declared as tree inputs, read through slots cached per entity
+struct BehInputs
+{
+  const Blackboard &bb;
+  const size_t *slots;
+
+  float operator[](uint16_t input) const { return bb.get<float>(slots[input]); }
+};
+
+using compiled_utility_function = std::function<float(const BehInputs&)>;
+
+// Immutable, shared by all entities of an archetype
+struct CompiledBehTree
+{
+  std::vector<CompiledBehNode> nodes;
+  std::vector<compiled_utility_function> utilities;
+  std::vector<std::string> inputNames;
+  // options of curve utility selectors score bias + sum of their curves
+  std::vector<float> optionBiases;
+  std::vector<ResponseCurve> curves;
+  std::vector<uint16_t> curveOptions;
+  uint16_t numEntitySlots = 0;
+  uint16_t numPositionSlots = 0;
+  uint16_t numRunningSlots = 0;
+};
+
+// child a memory compound resumes from, only valid if it was running on the previous tick
+struct BehRunningChild
+{
+  uint16_t child = 0;
+  uint32_t tick = 0;
+};
+
+// per-entity data the tree works on, slots are resolved by name at build time
+struct BehTreeInstance
+{
+  const CompiledBehTree *tree = nullptr;
+  std::vector<flecs::entity> entities;
+  std::vector<Position> positions;
+  std::vector<size_t> inputSlots;
+  std::vector<BehRunningChild> running;
+  std::vector<float> optionScores; // written by score_beh_tree_utilities
+  uint32_t tick = 0;
+};
+
+// instances sharing one tree, scored together
+struct BehUtilityBatch
+{
+  const CompiledBehTree *tree = nullptr;
+  std::vector<BehTreeInstance*> instances;
+  std::vector<const Blackboard*> blackboards;
+};
+
+// world singleton with the scratch of score_beh_tree_utilities, reused every turn
+struct BehUtilityBatches
+{
+  std::vector<BehUtilityBatch> batches;
+  std::vector<float> inputs;
+  std::vector<float> scores;
+};
+
+class CompiledBehTreeBuilder
+{
+public:
+  // compound nodes are closed with end()
+  CompiledBehTreeBuilder &sequence();
+  CompiledBehTreeBuilder &selector();
+  CompiledBehTreeBuilder &utilitySelector();
+  // scored by response curves for all entities at once, see score_beh_tree_utilities
+  CompiledBehTreeBuilder &curveUtilitySelector();
+  // resume from the child that was running on the previous tick
+  CompiledBehTreeBuilder &memSequence();
+  CompiledBehTreeBuilder &memSelector();
+  // same as memory ones, but the first child is an abort condition checked every tick
+  CompiledBehTreeBuilder &reactiveSequence();
+  CompiledBehTreeBuilder &reactiveSelector();
+  // utility of the next child of the enclosing utility selector
+  CompiledBehTreeBuilder &utility(compiled_utility_function func);
+  // next child of the enclosing curve utility selector, curve() adds to its score
+  CompiledBehTreeBuilder &option(float bias);
+  CompiledBehTreeBuilder &curve(ResponseCurve curve);
+  CompiledBehTreeBuilder &end();
+
+  CompiledBehTreeBuilder &moveToEntity(const char *bb_name);
+  CompiledBehTreeBuilder &isLowHp(float thres);
+  CompiledBehTreeBuilder &findEnemy(float dist, const char *bb_name);
+  CompiledBehTreeBuilder &flee(const char *bb_name);
+  CompiledBehTreeBuilder &patrol(float patrol_dist, const char *bb_name);
+  CompiledBehTreeBuilder &patchUp(float thres);
+
+  // index to read the named blackboard float with from utilities
+  uint16_t input(const char *bb_name);
+
+  CompiledBehTree build();
+
+private:
+  CompiledBehTreeBuilder &push(CompiledBehNodeType type, float param = 0.f, uint16_t slot = 0);
+  CompiledBehTreeBuilder &open(CompiledBehNodeType type, uint16_t slot = 0);
+  uint16_t entitySlot(const char *bb_name);
+  uint16_t positionSlot(const char *bb_name);
+
+  CompiledBehTree tree;
+  struct OpenNode
+  {
+    size_t idx;
+    std::vector<compiled_utility_function> utilities;
+    std::vector<float> optionBiases;
+    std::vector<std::pair<uint16_t, ResponseCurve>> curves;
+  };
+  std::vector<OpenNode> openNodes;
+  std::unordered_map<std::string, uint16_t> entitySlots;
+  std::unordered_map<std::string, uint16_t> positionSlots;
+  std::unordered_map<std::string, uint16_t> inputs;
+};
+
+BehTreeInstance create_beh_tree_instance(const CompiledBehTree &tree, Blackboard &bb, const Position &spawn_pos);
+// evaluates option scores of curve utility selectors in column batches per tree
+void score_beh_tree_utilities(flecs::world &ecs);
+BehResult update_compiled_beh_tree(flecs::world &ecs, flecs::entity entity, BehTreeInstance &inst, Blackboard &bb);
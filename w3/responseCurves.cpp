@@ -0,0 +1,88 @@
+#include "responseCurves.h"
+#include <cassert>
+#include <cmath>
+
+ResponseCurve linear_curve(uint16_t input, float slope, float offset)
+{
+  ResponseCurve curve;
+  curve.type = RC_LINEAR;
+  curve.input = input;
+  curve.a = slope;
+  curve.b = offset;
+  return curve;
+}
+
+ResponseCurve quadratic_curve(uint16_t input, float a, float b, float c)
+{
+  ResponseCurve curve;
+  curve.type = RC_QUADRATIC;
+  curve.input = input;
+  curve.a = a;
+  curve.b = b;
+  curve.c = c;
+  return curve;
+}
+
+ResponseCurve logistic_curve(uint16_t input, float height, float steepness, float midpoint)
+{
+  ResponseCurve curve;
+  curve.type = RC_LOGISTIC;
+  curve.input = input;
+  curve.a = height;
+  curve.b = steepness;
+  curve.c = midpoint;
+  return curve;
+}
+
+ResponseCurve piecewise_curve(uint16_t input, std::vector<std::pair<float, float>> points)
+{
+  assert(!points.empty());
+  ResponseCurve curve;
+  curve.type = RC_PIECEWISE;
+  curve.input = input;
+  curve.points = std::move(points);
+  return curve;
+}
+
+void accumulate_response_curve(const ResponseCurve &curve, const float *in, float *out, size_t count)
+{
+  const float a = curve.a;
+  const float b = curve.b;
+  const float c = curve.c;
+  switch (curve.type)
+  {
+  case RC_LINEAR:
+    for (size_t i = 0; i < count; ++i)
+      out[i] += a * in[i] + b;
+    break;
+  case RC_QUADRATIC:
+    for (size_t i = 0; i < count; ++i)
+      out[i] += (a * in[i] + b) * in[i] + c;
+    break;
+  case RC_LOGISTIC:
+    for (size_t i = 0; i < count; ++i)
+      out[i] += a / (1.f + expf(-b * (in[i] - c)));
+    break;
+  case RC_PIECEWISE:
+  {
+    const std::vector<std::pair<float, float>> &pts = curve.points;
+    // one pass per segment, every value only takes the segment its x falls into
+    for (size_t i = 0; i < count; ++i)
+      out[i] += in[i] <= pts.front().first ? pts.front().second : pts.back().second;
+    for (size_t s = 0; s + 1 < pts.size(); ++s)
+    {
+      const float x0 = pts[s].first;
+      const float x1 = pts[s + 1].first;
+      const float y0 = pts[s].second;
+      const float y1 = pts[s + 1].second;
+      const float slope = x1 > x0 ? (y1 - y0) / (x1 - x0) : 0.f;
+      for (size_t i = 0; i < count; ++i)
+      {
+        const bool inside = in[i] > x0 && in[i] <= x1;
+        out[i] += inside ? y0 + slope * (in[i] - x0) - pts.back().second : 0.f;
+      }
+    }
+    break;
+  }
+  }
+}
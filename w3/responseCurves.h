@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+enum ResponseCurveType : uint8_t
+{
+  RC_LINEAR,
+  RC_QUADRATIC,
+  RC_LOGISTIC,
+  RC_PIECEWISE
+};
+
+// Maps one named input to a utility score term.
+struct ResponseCurve
+{
+  ResponseCurveType type = RC_LINEAR;
+  uint16_t input = 0;
+  float a = 0.f;
+  float b = 0.f;
+  float c = 0.f;
+  std::vector<std::pair<float, float>> points; // piecewise linear (x, y), sorted by x
+};
+
+// a * x + b
+ResponseCurve linear_curve(uint16_t input, float slope, float offset);
+// a * x^2 + b * x + c
+ResponseCurve quadratic_curve(uint16_t input, float a, float b, float c);
+// height / (1 + e^(-steepness * (x - midpoint)))
+ResponseCurve logistic_curve(uint16_t input, float height, float steepness, float midpoint);
+// clamped to the first and last point outside of their range
+ResponseCurve piecewise_curve(uint16_t input, std::vector<std::pair<float, float>> points);
+
+// out[i] += curve(in[i]), plain loops over columns so they vectorize
+void accumulate_response_curve(const ResponseCurve &curve, const float *in, float *out, size_t count);
@@ -3,24 +3,72 @@
 #include "raylib.h"
 #include "stateMachine.h"
 #include "aiLibrary.h"
+#include "compiledBehTree.h"
+#include "staticUtilitySelector.h"
+#include "aiUtils.h"
 #include "blackboard.h"
 #include "math.h"
 
+static void set_beh_tree_instance(flecs::entity e, const CompiledBehTree &tree)
+{
+  BehTreeInstance inst = create_beh_tree_instance(tree, *e.get_mut<Blackboard>(), *e.get<Position>());
+  e.set(std::move(inst));
+}
+
+static CompiledBehTree build_fuzzy_monster_beh()
+{
+  CompiledBehTreeBuilder builder;
+  const uint16_t hpInput = builder.input("hp");
+  const uint16_t enemyDistInput = builder.input("enemyDist");
+  return builder
+    .curveUtilitySelector()
+      .option(500.f)
+        .curve(linear_curve(hpInput, -5.f, 0.f))
+        .curve(linear_curve(enemyDistInput, -50.f, 0.f))
+      .sequence()
+        .findEnemy(4.f, "flee_enemy")
+        .flee("flee_enemy")
+      .end()
+      .option(100.f)
+        .curve(linear_curve(enemyDistInput, -10.f, 0.f))
+      .sequence()
+        .findEnemy(3.f, "attack_enemy")
+        .moveToEntity("attack_enemy")
+      .end()
+      .option(50.f)
+      .patrol(2.f, "patrol_pos")
+      .option(140.f)
+        .curve(linear_curve(hpInput, -1.f, 0.f))
+      .patchUp(100.f)
+    .end()
+    .build();
+}
+
 static void create_fuzzy_monster_beh(flecs::entity e)
 {
+  // built once, every fuzzy monster only keeps its own instance data
+  static const CompiledBehTree fuzzyMonsterBeh = build_fuzzy_monster_beh();
   e.set(Blackboard{});
+  set_beh_tree_instance(e, fuzzyMonsterBeh);
+  e.add<WorldInfoGatherer>();
+}
+
+// node based variant of the fuzzy monster, scorers are inlined into the selector
+static void create_static_fuzzy_monster_beh(flecs::entity e)
+{
+  e.set(Blackboard{});
+  const size_t hpBb = reg_entity_blackboard_var<float>(e, "hp");
+  const size_t enemyDistBb = reg_entity_blackboard_var<float>(e, "enemyDist");
   BehNode *root =
-    utility_selector({
+    static_utility_selector(
       std::make_pair(
         sequence({
           find_enemy(e, 4.f, "flee_enemy"),
           flee(e, "flee_enemy")
         }),
-        [](Blackboard &bb)
+        [=](Blackboard &bb)
         {
-          const float hp = bb.get<float>("hp");
-          const float enemyDist = bb.get<float>("enemyDist");
-          return (100.f - hp) * 5.f - 50.f * enemyDist;
+          return (100.f - bb.get<float>(hpBb)) * 5.f - 50.f * bb.get<float>(enemyDistBb);
         }
       ),
       std::make_pair(
@@ -28,10 +76,9 @@ static void create_fuzzy_monster_beh(flecs::entity e)
           find_enemy(e, 3.f, "attack_enemy"),
           move_to_entity(e, "attack_enemy")
         }),
-        [](Blackboard &bb)
+        [=](Blackboard &bb)
         {
-          const float enemyDist = bb.get<float>("enemyDist");
-          return 100.f - 10.f * enemyDist;
+          return 100.f - 10.f * bb.get<float>(enemyDistBb);
         }
       ),
       std::make_pair(
@@ -43,34 +90,38 @@ static void create_fuzzy_monster_beh(flecs::entity e)
       ),
       std::make_pair(
         patch_up(100.f),
-        [](Blackboard &bb)
+        [=](Blackboard &bb)
         {
-          const float hp = bb.get<float>("hp");
-          return 140.f - hp;
+          return 140.f - bb.get<float>(hpBb);
         }
       )
-    });
+    );
   e.add<WorldInfoGatherer>();
   e.set(BehaviourTree{root});
 }
 
 static void create_minotaur_beh(flecs::entity e)
 {
+  static const CompiledBehTree minotaurBeh = CompiledBehTreeBuilder()
+    .selector()
+      // hp and enemy range are re-checked every tick before fleeing on
+      .reactiveSequence()
+        .sequence()
+          .isLowHp(50.f)
+          .findEnemy(4.f, "flee_enemy")
+        .end()
+        .flee("flee_enemy")
+      .end()
+      // chase is dropped as soon as no enemy is in range
+      .reactiveSequence()
+        .findEnemy(3.f, "attack_enemy")
+        .moveToEntity("attack_enemy")
+      .end()
+      .patrol(2.f, "patrol_pos")
+    .end()
+    .build();
   e.set(Blackboard{});
-  BehNode *root =
-    selector({
-      sequence({
-        is_low_hp(50.f),
-        find_enemy(e, 4.f, "flee_enemy"),
-        flee(e, "flee_enemy")
-      }),
-      sequence({
-        find_enemy(e, 3.f, "attack_enemy"),
-        move_to_entity(e, "attack_enemy")
-      }),
-      patrol(e, 2.f, "patrol_pos")
-    });
-  e.set(BehaviourTree{root});
+  set_beh_tree_instance(e, minotaurBeh);
 }
 
 static flecs::entity create_monster(flecs::world &ecs, int x, int y, Color col, const char *texture_src)
@@ -194,7 +245,7 @@ void init_roguelike(flecs::world &ecs)
   create_fuzzy_monster_beh(create_monster(ecs, 5, 5, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"));
   create_fuzzy_monster_beh(create_monster(ecs, 10, -5, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"));
   create_fuzzy_monster_beh(create_monster(ecs, -5, -5, Color{0x11, 0x11, 0x11, 0xff}, "minotaur_tex"));
-  create_fuzzy_monster_beh(create_monster(ecs, -5, 5, Color{0, 255, 0, 255}, "minotaur_tex"));
+  create_static_fuzzy_monster_beh(create_monster(ecs, -5, 5, Color{0, 255, 0, 255}, "minotaur_tex"));
 
   create_player(ecs, 0, 0, "swordsman_tex");
 
@@ -208,6 +259,7 @@ void init_roguelike(flecs::world &ecs)
   ecs.entity("world")
     .set(TurnCounter{})
     .set(ActionLog{});
+  ecs.set(BehUtilityBatches{});
 }
 
 static bool is_player_acted(flecs::world &ecs)
@@ -385,6 +437,7 @@ void process_turn(flecs::world &ecs)
 {
   static auto stateMachineAct = ecs.query<StateMachine>();
   static auto behTreeUpdate = ecs.query<BehaviourTree, Blackboard>();
+  static auto compiledBehTreeUpdate = ecs.query<BehTreeInstance, Blackboard>();
   static auto turnIncrementer = ecs.query<TurnCounter>();
   if (is_player_acted(ecs))
   {
@@ -392,6 +445,7 @@ void process_turn(flecs::world &ecs)
     {
       // Plan action for NPCs
       gather_world_info(ecs);
+      score_beh_tree_utilities(ecs);
       ecs.defer([&]
       {
         stateMachineAct.each([&](flecs::entity e, StateMachine &sm)
@@ -402,6 +456,10 @@ void process_turn(flecs::world &ecs)
         {
           bt.update(ecs, e, bb);
         });
+        compiledBehTreeUpdate.each([&](flecs::entity e, BehTreeInstance &bt, Blackboard &bb)
+        {
+          update_compiled_beh_tree(ecs, e, bt, bb);
+        });
       });
       turnIncrementer.each([](TurnCounter &tc) { tc.count++; });
     }
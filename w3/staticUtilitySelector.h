@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include "behaviourTree.h"
+
+constexpr size_t maxUtilityChildren = 32; // tried children are tracked in a 32 bit mask
+
+// Tries children best score first, the next best is only searched for once the previous one fails.
+// Children past maxUtilityChildren are never tried.
+template<typename TryChild>
+inline BehResult select_best_first(const float *scores, size_t count, TryChild try_child)
+{
+  assert(count <= maxUtilityChildren);
+  count = std::min(count, maxUtilityChildren);
+  uint32_t tried = 0;
+  for (size_t attempt = 0; attempt < count; ++attempt)
+  {
+    size_t best = count;
+    for (size_t i = 0; i < count; ++i)
+      if (!(tried & (1u << i)) && (best == count || scores[i] > scores[best]))
+        best = i;
+    tried |= 1u << best;
+    BehResult res = try_child(best);
+    if (res != BEH_FAIL)
+      return res;
+  }
+  return BEH_FAIL;
+}
+
+// Utility selector with scorers known at compile time, so they inline instead of
+// going through std::function.
+template<typename... Scorers>
+struct StaticUtilitySelector : public BehNode
+{
+  std::array<BehNode*, sizeof...(Scorers)> nodes;
+  std::tuple<Scorers...> scorers;
+
+  StaticUtilitySelector(std::pair<BehNode*, Scorers>... in_nodes)
+    : nodes{in_nodes.first...}, scorers{in_nodes.second...} {}
+
+  ~StaticUtilitySelector()
+  {
+    for (BehNode *node : nodes)
+      delete node;
+  }
+
+  BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
+  {
+    std::array<float, sizeof...(Scorers)> scores;
+    std::apply([&](Scorers &...scorer)
+    {
+      size_t i = 0;
+      ((scores[i++] = scorer(bb)), ...);
+    }, scorers);
+    return select_best_first(scores.data(), scores.size(), [&](size_t i)
+    {
+      return nodes[i]->update(ecs, entity, bb);
+    });
+  }
+};
+
+template<typename... Scorers>
+BehNode *static_utility_selector(std::pair<BehNode*, Scorers>... nodes)
+{
+  static_assert(sizeof...(Scorers) <= maxUtilityChildren);
+  return new StaticUtilitySelector<Scorers...>(nodes...);
+}
@@ -0,0 +1,217 @@
+#include "coopPathfinder.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <queue>
+
+// how many turns ahead paths are planned and how often the whole group replans
+constexpr int coopWindow = 8;
+constexpr int coopReplanPeriod = coopWindow / 2;
+// an agent that found no path waits this long before asking for a replan again
+constexpr int coopFailedPlanWait = 2;
+
+static uint64_t reservation_key(int turn, Position p, size_t width)
+{
+  return (uint64_t(uint32_t(turn)) << 32) | uint64_t(size_t(p.y) * width + size_t(p.x));
+}
+
+static bool is_reserved(const ReservationTable &rt, int turn, Position p, size_t width, flecs::entity_t self)
+{
+  auto it = rt.reserved.find(reservation_key(turn, p, width));
+  return it != rt.reserved.end() && it->second != self;
+}
+
+// first come first served, returns false if someone else already holds the tile
+static bool reserve(ReservationTable &rt, int turn, Position p, size_t width, flecs::entity_t e)
+{
+  auto res = rt.reserved.emplace(reservation_key(turn, p, width), e);
+  return res.second || res.first->second == e;
+}
+
+static void release(ReservationTable &rt, int turn, Position p, size_t width, flecs::entity_t e)
+{
+  auto it = rt.reserved.find(reservation_key(turn, p, width));
+  if (it != rt.reserved.end() && it->second == e)
+    rt.reserved.erase(it);
+}
+
+static int move_action(Position from, Position to)
+{
+  if (to.x < from.x)
+    return EA_MOVE_LEFT;
+  if (to.x > from.x)
+    return EA_MOVE_RIGHT;
+  if (to.y < from.y)
+    return EA_MOVE_UP;
+  if (to.y > from.y)
+    return EA_MOVE_DOWN;
+  return EA_NOP;
+}
+
+// A* over (x, y, t), t in [0, coopWindow]; approach map is the true distance
+// to the goal without other agents, so it's used as heuristic past the window.
+static std::vector<Position> find_space_time_path(const DungeonData &dd, const DijkstraMapData &approach,
+                                                  const ReservationTable &rt, flecs::entity_t self,
+                                                  Position from, int turn)
+{
+  auto heuristic = [&](Position p) { return approach.map[size_t(p.y) * dd.width + size_t(p.x)]; };
+
+  struct Node
+  {
+    Position pos;
+    int t;
+    float g;
+    float f;
+    int prev;
+  };
+  std::vector<Node> nodes;
+  auto cmp = [&](int lhs, int rhs) { return nodes[size_t(lhs)].f > nodes[size_t(rhs)].f; };
+  std::priority_queue<int, std::vector<int>, decltype(cmp)> openList(cmp);
+  std::unordered_map<uint64_t, float> bestG;
+
+  nodes.push_back({from, 0, 0.f, heuristic(from), -1});
+  openList.push(0);
+  const Position moves[] = {{0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  while (!openList.empty())
+  {
+    const int cur = openList.top();
+    openList.pop();
+    const Node node = nodes[size_t(cur)];
+    // adjacent to an enemy or at the window horizon
+    if (node.t == coopWindow || heuristic(node.pos) <= 1.f)
+    {
+      std::vector<Position> res;
+      for (int idx = cur; idx >= 0; idx = nodes[size_t(idx)].prev)
+        res.push_back(nodes[size_t(idx)].pos);
+      std::reverse(res.begin(), res.end());
+      return res;
+    }
+    for (const Position &m : moves)
+    {
+      const Position next{node.pos.x + m.x, node.pos.y + m.y};
+      if (!dd.is_walkable(next.x, next.y))
+        continue;
+      const int t = node.t + 1;
+      // don't step into a tile someone is leaving this turn, process_actions would block that move
+      if (is_reserved(rt, turn + t, next, dd.width, self) ||
+          (next != node.pos && is_reserved(rt, turn + node.t, next, dd.width, self)))
+        continue;
+      const float g = node.g + 1.f;
+      const uint64_t key = reservation_key(t, next, dd.width);
+      auto it = bestG.find(key);
+      if (it != bestG.end() && it->second <= g)
+        continue;
+      bestG[key] = g;
+      nodes.push_back({next, t, g, g + heuristic(next), cur});
+      openList.push(int(nodes.size()) - 1);
+    }
+  }
+  return {from};
+}
+
+flecs::entity create_coop_approacher(flecs::entity e)
+{
+  e.set(CoopPathAgent{});
+  return e;
+}
+
+void process_coop_path_agents(flecs::world &ecs)
+{
+  static auto agentsQuery = ecs.query<const Position, Action, CoopPathAgent>();
+  static auto charactersQuery = ecs.query<const Position, const Team>();
+  static auto reservationQuery = ecs.query<ReservationTable, const TurnCounter>();
+
+  const DijkstraMapData *approach = ecs.entity("approach_map").get<DijkstraMapData>();
+  if (!approach)
+    return;
+  const DungeonData &dd = *ecs.get<DungeonData>();
+  auto approach_at = [&](Position p) { return approach->map[size_t(p.y) * dd.width + size_t(p.x)]; };
+  reservationQuery.each([&](ReservationTable &rt, const TurnCounter &tc)
+  {
+    const int turn = tc.count;
+    // group replans periodically or as soon as someone is off the plan
+    bool replan = rt.planTurn < 0 || turn - rt.planTurn >= coopReplanPeriod;
+    agentsQuery.each([&](const Position &pos, Action &, CoopPathAgent &agent)
+    {
+      if (approach_at(pos) <= 1.f)
+        return;
+      if (turn < agent.retryTurn)
+        return;
+      const int idx = turn - agent.startTurn;
+      if (idx < 0 || idx + 1 >= int(agent.path.size()) || agent.path[size_t(idx)] != pos)
+        replan = true;
+    });
+
+    if (replan)
+    {
+      rt.reserved.clear();
+      rt.planTurn = turn;
+      // we don't know where everyone else goes, so treat them as standing still for the whole window
+      charactersQuery.each([&](flecs::entity e, const Position &pos, const Team &)
+      {
+        if (e.has<CoopPathAgent>())
+          return;
+        for (int t = 0; t <= coopWindow + 1; ++t)
+          reserve(rt, turn + t, pos, dd.width, e);
+      });
+      struct PlanRequest
+      {
+        flecs::entity e;
+        Position pos;
+        CoopPathAgent *agent;
+      };
+      std::vector<PlanRequest> requests;
+      agentsQuery.each([&](flecs::entity e, const Position &pos, Action &, CoopPathAgent &agent)
+      {
+        reserve(rt, turn, pos, dd.width, e);
+        requests.push_back({e, pos, &agent});
+      });
+      // closest to the goal get priority
+      std::sort(requests.begin(), requests.end(), [&](const PlanRequest &lhs, const PlanRequest &rhs)
+      {
+        return approach_at(lhs.pos) < approach_at(rhs.pos);
+      });
+      for (PlanRequest &req : requests)
+      {
+        std::vector<Position> &path = req.agent->path;
+        path = find_space_time_path(dd, *approach, rt, req.e, req.pos, turn);
+        req.agent->startTurn = turn;
+        bool failed = path.size() < 2 && approach_at(req.pos) > 1.f;
+        // stay at the end of the path for the rest of the window
+        auto pathAt = [&](int t) { return path[std::min(size_t(t), path.size() - 1)]; };
+        int reservedUntil = 0;
+        while (reservedUntil <= coopWindow + 1 && reserve(rt, turn + reservedUntil, pathAt(reservedUntil), dd.width, req.e))
+          reservedUntil++;
+        if (reservedUntil <= coopWindow + 1)
+        {
+          // a tile is already taken by someone with higher priority (e.g. the standing fallback path
+          // crosses their plan), drop the whole plan and wait in place
+          for (int t = 1; t < reservedUntil; ++t)
+            release(rt, turn + t, pathAt(t), dd.width, req.e);
+          path = {req.pos};
+          failed = true;
+        }
+        req.agent->retryTurn = failed ? turn + coopFailedPlanWait : turn;
+      }
+    }
+
+    agentsQuery.each([&](const Position &pos, Action &act, const CoopPathAgent &agent)
+    {
+      act.action = EA_NOP;
+      if (approach_at(pos) <= 1.f)
+      {
+        // attack by moving into the enemy
+        const Position neighbours[] = {{pos.x - 1, pos.y}, {pos.x + 1, pos.y}, {pos.x, pos.y - 1}, {pos.x, pos.y + 1}};
+        for (const Position &n : neighbours)
+          if (approach_at(n) == 0.f)
+          {
+            act.action = move_action(pos, n);
+            break;
+          }
+        return;
+      }
+      const int idx = turn - agent.startTurn;
+      if (idx >= 0 && idx + 1 < int(agent.path.size()))
+        act.action = move_action(pos, agent.path[size_t(idx) + 1]);
+    });
+  });
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include <unordered_map>
+#include "ecsTypes.h"
+
+// Windowed cooperative A* (WHCA*): agents are planned together against a shared
+// space-time reservation table, so their paths don't run into each other.
+struct CoopPathAgent
+{
+  std::vector<Position> path; // path[i] is where agent should be at turn startTurn + i
+  int startTurn = 0;
+  int retryTurn = 0; // no replan requests before this turn, set when no path was found
+};
+
+struct ReservationTable
+{
+  std::unordered_map<uint64_t, flecs::entity_t> reserved; // (turn, tile) -> reserving entity
+  int planTurn = -1;
+};
+
+flecs::entity create_coop_approacher(flecs::entity e);
+void process_coop_path_agents(flecs::world &ecs);
@@ -5,9 +5,7 @@
 template<typename Callable>
 static void query_dungeon_data(flecs::world &ecs, Callable c)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
-
-  dungeonDataQuery.each(c);
+  c(*ecs.get<DungeonData>());
 }
 
 template<typename Callable>
@@ -31,15 +29,15 @@ static void init_tiles(std::vector<float> &map, const DungeonData &dd)
 static void process_dmap(std::vector<float> &map, const DungeonData &dd)
 {
   bool done = false;
-  auto getMapAt = [&](size_t x, size_t y, float def)
+  auto getMapAt = [&](int x, int y, float def)
   {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
-      return map[y * dd.width + x];
+    if (dd.is_walkable(x, y))
+      return map[size_t(y) * dd.width + size_t(x)];
     return def;
   };
-  auto getMinNei = [&](size_t x, size_t y)
+  auto getMinNei = [&](int x, int y)
   {
-    float val = map[y * dd.width + x];
+    float val = map[size_t(y) * dd.width + size_t(x)];
     val = std::min(val, getMapAt(x - 1, y + 0, val));
     val = std::min(val, getMapAt(x + 1, y + 0, val));
     val = std::min(val, getMapAt(x + 0, y - 1, val));
@@ -49,11 +47,11 @@ static void process_dmap(std::vector<float> &map, const DungeonData &dd)
   while (!done)
   {
     done = true;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
+    for (int y = 0; y < int(dd.height); ++y)
+      for (int x = 0; x < int(dd.width); ++x)
       {
-        const size_t i = y * dd.width + x;
-        if (dd.tiles[i] != dungeon::floor)
+        const size_t i = size_t(y) * dd.width + size_t(x);
+        if (!dd.is_walkable(x, y))
           continue;
         const float myVal = getMapAt(x, y, invalid_tile_value);
         const float minVal = getMinNei(x, y);
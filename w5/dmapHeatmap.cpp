@@ -0,0 +1,71 @@
+#include "dmapHeatmap.h"
+#include "ecsTypes.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr float invalid_tile_value = 1e5f;
+
+static void bake_heatmap(flecs::entity e, const DungeonData &dd, std::vector<float> values)
+{
+  float minVal = invalid_tile_value;
+  float maxVal = -invalid_tile_value;
+  for (float v : values)
+    if (v < invalid_tile_value)
+    {
+      minVal = std::min(minVal, v);
+      maxVal = std::max(maxVal, v);
+    }
+  const float range = maxVal > minVal ? maxVal - minVal : 1.f;
+  // blue is low, red is high, unreachable tiles stay transparent
+  std::vector<Color> pixels(values.size(), BLANK);
+  for (size_t i = 0; i < values.size(); ++i)
+    if (values[i] < invalid_tile_value)
+      pixels[i] = Fade(ColorFromHSV((1.f - (values[i] - minVal) / range) * 240.f, 0.8f, 1.f), 0.5f);
+
+  if (!e.has<DmapHeatmap>())
+  {
+    Image img = GenImageColor(int(dd.width), int(dd.height), BLANK);
+    Texture2D tex = LoadTextureFromImage(img);
+    UnloadImage(img);
+    SetTextureFilter(tex, TEXTURE_FILTER_POINT);
+    e.set(DmapHeatmap{tex, {}});
+  }
+  DmapHeatmap *heatmap = e.get_mut<DmapHeatmap>();
+  UpdateTexture(heatmap->texture, pixels.data());
+  heatmap->values = std::move(values);
+}
+
+void bake_dmap_heatmaps(flecs::world &ecs)
+{
+  static auto rawMapsQuery = ecs.query<const DijkstraMapData, const VisualiseMap>();
+  static auto compositeMapsQuery = ecs.query<const DmapWeights, const VisualiseMap>();
+
+  const DungeonData &dd = *ecs.get<DungeonData>();
+  // gather first, baking may add DmapHeatmap and we can't do that while iterating
+  std::vector<std::pair<flecs::entity, std::vector<float>>> maps;
+  rawMapsQuery.each([&](flecs::entity e, const DijkstraMapData &dmap, const VisualiseMap)
+  {
+    maps.emplace_back(e, dmap.map);
+  });
+  compositeMapsQuery.each([&](flecs::entity e, const DmapWeights &wt, const VisualiseMap)
+  {
+    std::vector<float> sum(dd.width * dd.height, 0.f);
+    for (const auto &pair : wt.weights)
+    {
+      ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
+      {
+        for (size_t i = 0; i < sum.size(); ++i)
+        {
+          const float v = dmap.map[i];
+          if (v < invalid_tile_value)
+            sum[i] += powf(v * pair.second.mult, pair.second.pow);
+          else
+            sum[i] += v;
+        }
+      });
+    }
+    maps.emplace_back(e, std::move(sum));
+  });
+  for (auto &map : maps)
+    bake_heatmap(map.first, dd, std::move(map.second));
+}
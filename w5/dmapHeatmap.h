@@ -0,0 +1,14 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include "raylib.h"
+
+// Dijkstra map (or weighted sum of them) baked into a one texel per tile texture
+struct DmapHeatmap
+{
+  Texture2D texture;
+  std::vector<float> values; // kept for labels, >= 1e5 is unreachable
+};
+
+// call whenever dmaps are regenerated, bakes every entity marked with VisualiseMap
+void bake_dmap_heatmaps(flecs::world &ecs);
@@ -1,37 +1,61 @@
 #include "dungeonUtils.h"
 #include "raylib.h"
 
-Position dungeon::find_walkable_tile(flecs::world &ecs)
+DungeonData dungeon::make_dungeon_data(const char *tiles, size_t w, size_t h)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  DungeonData dd{std::vector<char>(tiles, tiles + w * h), w, h, {},
+                 std::vector<uint64_t>(((w + 2) * (h + 2) + 63) / 64, 0)};
+  for (size_t y = 0; y < h; ++y)
+    for (size_t x = 0; x < w; ++x)
+      if (tiles[y * w + x] == dungeon::floor)
+      {
+        dd.floorTiles.push_back(Position{int(x), int(y)});
+        const size_t bit = (y + 1) * (w + 2) + (x + 1);
+        dd.passable[bit >> 6] |= uint64_t(1) << (bit & 63);
+      }
+  return dd;
+}
+
+static constexpr size_t not_free = ~size_t(0);
 
-  Position res{0, 0};
-  dungeonDataQuery.each([&](const DungeonData &dd)
-  {
-    // prebuild all walkable and get one of them
-    std::vector<Position> posList;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-        if (dd.tiles[y * dd.width + x] == dungeon::floor)
-          posList.push_back(Position{int(x), int(y)});
-    size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
-    res = posList[rndIdx];
-  });
-  return res;
+DungeonOccupancy dungeon::make_occupancy(const DungeonData &dd)
+{
+  DungeonOccupancy occ{std::vector<uint64_t>(dd.width * dd.height, 0), dd.width, dd.height,
+                       dd.floorTiles, std::vector<size_t>(dd.width * dd.height, not_free)};
+  for (size_t i = 0; i < occ.freeTiles.size(); ++i)
+    occ.freeSlot[size_t(occ.freeTiles[i].y) * occ.width + size_t(occ.freeTiles[i].x)] = i;
+  return occ;
 }
 
-bool dungeon::is_tile_walkable(flecs::world &ecs, Position pos)
+std::optional<Position> dungeon::find_free_tile(flecs::world &ecs)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  const DungeonOccupancy &occ = *ecs.get<DungeonOccupancy>();
+  if (occ.freeTiles.empty())
+    return std::nullopt;
+  size_t rndIdx = size_t(GetRandomValue(0, int(occ.freeTiles.size()) - 1));
+  return occ.freeTiles[rndIdx];
+}
 
-  bool res = false;
-  dungeonDataQuery.each([&](const DungeonData &dd)
-  {
-    if (pos.x < 0 || pos.x >= int(dd.width) ||
-        pos.y < 0 || pos.y >= int(dd.height))
-      return;
-    res = dd.tiles[size_t(pos.y) * dd.width + size_t(pos.x)] == dungeon::floor;
-  });
-  return res;
+void dungeon::occupy(DungeonOccupancy &occ, Position pos, uint64_t e)
+{
+  const size_t idx = size_t(pos.y) * occ.width + size_t(pos.x);
+  occ.tiles[idx] = e;
+  const size_t slot = occ.freeSlot[idx];
+  if (slot == not_free)
+    return;
+  const Position &last = occ.freeTiles.back();
+  occ.freeSlot[size_t(last.y) * occ.width + size_t(last.x)] = slot;
+  occ.freeTiles[slot] = last;
+  occ.freeTiles.pop_back();
+  occ.freeSlot[idx] = not_free;
 }
 
+void dungeon::vacate(DungeonOccupancy &occ, Position pos, uint64_t e)
+{
+  const size_t idx = size_t(pos.y) * occ.width + size_t(pos.x);
+  if (occ.tiles[idx] != e)
+    return;
+  occ.tiles[idx] = 0;
+  occ.freeSlot[idx] = occ.freeTiles.size();
+  occ.freeTiles.push_back(pos);
+}
@@ -1,12 +1,17 @@
 #pragma once
 #include "ecsTypes.h"
 #include <flecs.h>
+#include <optional>
 
 namespace dungeon
 {
   constexpr char wall = '#';
   constexpr char floor = ' ';
 
-  Position find_walkable_tile(flecs::world &ecs);
-  bool is_tile_walkable(flecs::world &ecs, Position pos);
+  DungeonData make_dungeon_data(const char *tiles, size_t w, size_t h);
+  DungeonOccupancy make_occupancy(const DungeonData &dd);
+  // nullopt when every floor tile is taken
+  std::optional<Position> find_free_tile(flecs::world &ecs);
+  void occupy(DungeonOccupancy &occ, Position pos, uint64_t e);
+  void vacate(DungeonOccupancy &occ, Position pos, uint64_t e);
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -136,13 +137,53 @@ struct ActionLog
   size_t capacity = 5;
 };
 
-struct BackgroundTile {};
-
 struct DungeonData
 {
   std::vector<char> tiles; // for pathfinding
   size_t width;
   size_t height;
+  std::vector<Position> floorTiles; // prebuilt for random picks
+  std::vector<uint64_t> passable; // bit per tile, padded with a wall border so -1..width and -1..height are valid
+
+  bool is_walkable(int x, int y) const
+  {
+    const size_t bit = size_t(y + 1) * (width + 2) + size_t(x + 1);
+    return (passable[bit >> 6] >> (bit & 63)) & 1;
+  }
+};
+
+// which entity stands on a tile, 0 if none
+// free floor tiles are kept in a swap-remove list, freeSlot maps a tile to its place there
+struct DungeonOccupancy
+{
+  std::vector<uint64_t> tiles;
+  size_t width;
+  size_t height;
+  std::vector<Position> freeTiles;
+  std::vector<size_t> freeSlot;
+};
+
+// pickup entities by tile_key of their position
+struct PickupIndex
+{
+  std::unordered_multimap<uint64_t, uint64_t> pickups;
+};
+
+inline uint64_t tile_key(const Position &p) { return (uint64_t(uint32_t(p.y)) << 32) | uint64_t(uint32_t(p.x)); }
+
+// tiles seen by the camera this frame, max is exclusive
+struct VisibleTiles
+{
+  int minX = 0;
+  int minY = 0;
+  int maxX = 0;
+  int maxY = 0;
+};
+
+struct CursorTile
+{
+  int x = 0;
+  int y = 0;
 };
 
 struct DijkstraMapData
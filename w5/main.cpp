@@ -239,6 +239,7 @@ int main(int /*argc*/, const char ** /*argv*/)
   {
     process_turn(ecs);
     update_camera(camera, ecs);
+    update_visible_tiles(ecs, camera);
 
     BeginDrawing();
       ClearBackground(BLACK);
@@ -0,0 +1,31 @@
+#include "renderQueue.h"
+#include <algorithm>
+
+void push_sprite(RenderQueue &rq, int layer, Texture2D tex, Rectangle src, Rectangle dst, Color color)
+{
+  rq.items.push_back(RenderItem{tex, src, dst, color, layer});
+}
+
+void push_rect(RenderQueue &rq, int layer, Rectangle dst, Color color)
+{
+  rq.items.push_back(RenderItem{Texture2D{}, Rectangle{}, dst, color, layer});
+}
+
+void flush_render_queue(RenderQueue &rq)
+{
+  // stable to keep submission order inside a layer, e.g. hp bar background under the bar
+  std::stable_sort(rq.items.begin(), rq.items.end(), [](const RenderItem &lhs, const RenderItem &rhs)
+  {
+    if (lhs.layer != rhs.layer)
+      return lhs.layer < rhs.layer;
+    return lhs.texture.id < rhs.texture.id;
+  });
+  for (const RenderItem &item : rq.items)
+  {
+    if (item.texture.id == 0)
+      DrawRectangleRec(item.dst, item.color);
+    else
+      DrawTexturePro(item.texture, item.src, item.dst, Vector2{0, 0}, 0.f, item.color);
+  }
+  rq.items.clear();
+}
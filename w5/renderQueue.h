@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include "raylib.h"
+
+enum RenderLayer
+{
+  RL_BACKGROUND = 0,
+  RL_DEBUG_MAP,
+  RL_PICKUPS,
+  RL_ACTORS,
+  RL_HP_BARS,
+  RL_NUM
+};
+
+// texture resolved once at creation instead of following TextureSource every frame
+struct Sprite
+{
+  Texture2D texture;
+};
+
+struct RenderItem
+{
+  Texture2D texture; // id 0 draws a plain rectangle
+  Rectangle src;
+  Rectangle dst;
+  Color color;
+  int layer;
+};
+
+struct RenderQueue
+{
+  std::vector<RenderItem> items;
+};
+
+void push_sprite(RenderQueue &rq, int layer, Texture2D tex, Rectangle src, Rectangle dst, Color color);
+void push_rect(RenderQueue &rq, int layer, Rectangle dst, Color color);
+// sorts by layer then texture, so same texture runs end up in one raylib batch
+void flush_render_queue(RenderQueue &rq);
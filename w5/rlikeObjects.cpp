@@ -2,6 +2,7 @@
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
 #include "blackboard.h"
+#include "renderQueue.h"
 
 flecs::entity create_hive(flecs::entity e)
 {
@@ -9,28 +10,12 @@ flecs::entity create_hive(flecs::entity e)
   return e;
 }
 
-static Position find_free_dungeon_tile(flecs::world &ecs)
-{
-  static auto findMonstersQuery = ecs.query<const Position, const Hitpoints>();
-  bool done = false;
-  while (!done)
-  {
-    done = true;
-    Position pos = dungeon::find_walkable_tile(ecs);
-    findMonstersQuery.each([&](const Position &p, const Hitpoints&)
-    {
-      if (p == pos)
-        done = false;
-    });
-    if (done)
-      return pos;
-  };
-  return {0, 0};
-}
-
 flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_src)
 {
-  Position pos = find_free_dungeon_tile(ecs);
+  const std::optional<Position> freeTile = dungeon::find_free_tile(ecs);
+  if (!freeTile)
+    return flecs::entity();
+  const Position pos = *freeTile;
 
   flecs::entity textureSrc = ecs.entity(texture_src);
   return ecs.entity()
@@ -40,6 +25,7 @@ flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_s
     .set(Action{EA_NOP})
     .set(Color{col})
     .add<TextureSource>(textureSrc)
+    .set(Sprite{*textureSrc.get<Texture2D>()})
     .set(Team{1})
     .set(NumActions{1, 0})
     .set(MeleeDamage{20.f})
@@ -48,7 +34,10 @@ flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_s
 
 void create_player(flecs::world &ecs, const char *texture_src)
 {
-  Position pos = find_free_dungeon_tile(ecs);
+  const std::optional<Position> freeTile = dungeon::find_free_tile(ecs);
+  if (!freeTile)
+    return;
+  const Position pos = *freeTile;
 
   flecs::entity textureSrc = ecs.entity(texture_src);
   ecs.entity("player")
@@ -62,6 +51,7 @@ void create_player(flecs::world &ecs, const char *texture_src)
     .set(NumActions{2, 0})
     .set(Color{255, 255, 255, 255})
     .add<TextureSource>(textureSrc)
+    .set(Sprite{*textureSrc.get<Texture2D>()})
     .set(MeleeDamage{50.f});
 }
 
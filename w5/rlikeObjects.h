@@ -3,6 +3,7 @@
 #include "raylib.h"
 
 flecs::entity create_hive(flecs::entity e);
+// empty entity if there was no free tile to spawn on
 flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_src);
 void create_player(flecs::world &ecs, const char *texture_src);
 void create_heal(flecs::world &ecs, int x, int y, float amount);
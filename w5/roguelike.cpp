@@ -10,11 +10,23 @@
 #include "dmapFollower.h"
 #include "dmapBeh.h"
 #include "rlikeObjects.h"
+#include "coopPathfinder.h"
+#include "tilemap.h"
+#include "renderQueue.h"
+#include "dmapHeatmap.h"
+#include <algorithm>
 
 
+template<typename Callable>
+static void for_each_visible_tile(const VisibleTiles &vis, Callable c)
+{
+  for (int y = vis.minY; y < vis.maxY; ++y)
+    for (int x = vis.minX; x < vis.maxX; ++x)
+      c(x, y);
+}
+
 static void register_roguelike_systems(flecs::world &ecs)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
   ecs.system<PlayerInput, Action, const IsPlayer>()
     .each([&](PlayerInput &inp, Action &a, const IsPlayer)
     {
@@ -35,93 +47,137 @@ static void register_roguelike_systems(flecs::world &ecs)
       inp.up = up;
       inp.down = down;
     });
-  ecs.system<const Position, const Color>()
-    .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
+  static auto renderQueueQuery = ecs.query<RenderQueue>();
+  ecs.system<const DmapHeatmap>()
+    .term<VisualiseMap>()
+    .each([&](const DmapHeatmap &heatmap)
     {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size}, color);
+      renderQueueQuery.each([&](RenderQueue &rq)
+      {
+        const Texture2D &tex = heatmap.texture;
+        push_sprite(rq, RL_DEBUG_MAP, tex, Rectangle{0, 0, float(tex.width), float(tex.height)},
+            Rectangle{0, 0, float(tex.width) * tile_size, float(tex.height) * tile_size}, WHITE);
+      });
     });
-  ecs.system<const Position, const Color>()
-    .term<TextureSource>(flecs::Wildcard).not_()
-    .each([&](const Position &pos, const Color color)
+  // pickups and actors are found through the tile indices, so off-screen ones aren't iterated at all
+  static auto tilemapQuery = ecs.query<const Tilemap>();
+  ecs.system<RenderQueue>()
+    .each([&](RenderQueue &rq)
     {
-      const Rectangle rect = {float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size};
-      DrawRectangleRec(rect, color);
+      const VisibleTiles &vis = *ecs.get<VisibleTiles>();
+      tilemapQuery.each([&](const Tilemap &tm)
+      {
+        push_tilemap(rq, tm, vis);
+      });
+      const PickupIndex &pi = *ecs.get<PickupIndex>();
+      for_each_visible_tile(vis, [&](int x, int y)
+      {
+        auto range = pi.pickups.equal_range(tile_key(Position{x, y}));
+        for (auto it = range.first; it != range.second; ++it)
+          if (const Color *color = ecs.entity(it->second).get<Color>())
+            push_rect(rq, RL_PICKUPS, Rectangle{float(x) * tile_size, float(y) * tile_size, tile_size, tile_size}, *color);
+      });
+      const DungeonOccupancy &occ = *ecs.get<DungeonOccupancy>();
+      for_each_visible_tile(vis, [&](int x, int y)
+      {
+        const uint64_t occupant = occ.tiles[size_t(y) * occ.width + size_t(x)];
+        if (!occupant)
+          return;
+        flecs::entity e = ecs.entity(occupant);
+        const Position *pos = e.get<Position>();
+        if (!pos)
+          return;
+        const Sprite *sprite = e.get<Sprite>();
+        const Color *color = e.get<Color>();
+        if (sprite && color)
+          push_sprite(rq, RL_ACTORS, sprite->texture,
+              Rectangle{0, 0, float(sprite->texture.width), float(sprite->texture.height)},
+              Rectangle{float(pos->x) * tile_size, float(pos->y) * tile_size, tile_size, tile_size}, *color);
+        if (const Hitpoints *hp = e.get<Hitpoints>())
+        {
+          constexpr float hpPadding = 0.05f;
+          const float hpWidth = 1.f - 2.f * hpPadding;
+          const Rectangle underRect = {float(pos->x + hpPadding) * tile_size, float(pos->y-0.25f) * tile_size,
+                                       hpWidth * tile_size, 0.1f * tile_size};
+          push_rect(rq, RL_HP_BARS, underRect, BLACK);
+          const Rectangle hpRect = {float(pos->x + hpPadding) * tile_size, float(pos->y-0.25f) * tile_size,
+                                    hp->hitpoints / 100.f * hpWidth * tile_size, 0.1f * tile_size};
+          push_rect(rq, RL_HP_BARS, hpRect, RED);
+        }
+      });
+      flush_render_queue(rq);
     });
-  ecs.system<const Position, const Color>()
-    .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>().not_()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
+
+  // observers can fire while deferred commands are flushed, where get_mut would hand out
+  // a command copy, so they write to the singletons through refs instead
+  flecs::ref<DungeonOccupancy> occupancy = ecs.singleton<DungeonOccupancy>().get_ref<DungeonOccupancy>();
+  flecs::ref<PickupIndex> pickupIndex = ecs.singleton<PickupIndex>().get_ref<PickupIndex>();
+  ecs.observer<const MovePos>()
+    .event(flecs::OnSet)
+    .each([occupancy](flecs::entity e, const MovePos &mpos) mutable
     {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size}, color);
+      dungeon::occupy(*occupancy.get(), Position{mpos.x, mpos.y}, e);
     });
-  ecs.system<const Position, const Hitpoints>()
-    .each([&](const Position &pos, const Hitpoints &hp)
+  ecs.observer<const MovePos>()
+    .event(flecs::OnRemove)
+    .each([occupancy](flecs::entity e, const MovePos &mpos) mutable
     {
-      constexpr float hpPadding = 0.05f;
-      const float hpWidth = 1.f - 2.f * hpPadding;
-      const Rectangle underRect = {float(pos.x + hpPadding) * tile_size, float(pos.y-0.25f) * tile_size,
-                                   hpWidth * tile_size, 0.1f * tile_size};
-      DrawRectangleRec(underRect, BLACK);
-      const Rectangle hpRect = {float(pos.x + hpPadding) * tile_size, float(pos.y-0.25f) * tile_size,
-                                hp.hitpoints / 100.f * hpWidth * tile_size, 0.1f * tile_size};
-      DrawRectangleRec(hpRect, RED);
+      dungeon::vacate(*occupancy.get(), Position{mpos.x, mpos.y}, e);
     });
 
+  auto index_pickup = [pickupIndex](flecs::entity e) mutable
+  {
+    if (const Position *pos = e.get<Position>())
+      pickupIndex->pickups.emplace(tile_key(*pos), e);
+  };
+  auto unindex_pickup = [pickupIndex](flecs::entity e) mutable
+  {
+    const Position *pos = e.get<Position>();
+    if (!pos)
+      return;
+    PickupIndex &pi = *pickupIndex.get();
+    auto range = pi.pickups.equal_range(tile_key(*pos));
+    for (auto it = range.first; it != range.second; ++it)
+      if (it->second == e)
+      {
+        pi.pickups.erase(it);
+        break;
+      }
+  };
+  ecs.observer<const HealAmount>()
+    .event(flecs::OnSet)
+    .each([index_pickup](flecs::entity e, const HealAmount &) mutable { index_pickup(e); });
+  ecs.observer<const PowerupAmount>()
+    .event(flecs::OnSet)
+    .each([index_pickup](flecs::entity e, const PowerupAmount &) mutable { index_pickup(e); });
+  ecs.observer<const HealAmount>()
+    .event(flecs::OnRemove)
+    .each([unindex_pickup](flecs::entity e, const HealAmount &) mutable { unindex_pickup(e); });
+  ecs.observer<const PowerupAmount>()
+    .event(flecs::OnRemove)
+    .each([unindex_pickup](flecs::entity e, const PowerupAmount &) mutable { unindex_pickup(e); });
+
   ecs.system<Texture2D>()
     .each([&](Texture2D &tex)
     {
       SetTextureFilter(tex, TEXTURE_FILTER_POINT);
     });
-  ecs.system<const DmapWeights>()
-    .term<VisualiseMap>()
-    .each([&](const DmapWeights &wt)
-    {
-      dungeonDataQuery.each([&](const DungeonData &dd)
-      {
-        for (size_t y = 0; y < dd.height; ++y)
-          for (size_t x = 0; x < dd.width; ++x)
-          {
-            float sum = 0.f;
-            for (const auto &pair : wt.weights)
-            {
-              ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
-              {
-                float v = dmap.map[y * dd.width + x];
-                if (v < 1e5f)
-                  sum += powf(v * pair.second.mult, pair.second.pow);
-                else
-                  sum += v;
-              });
-            }
-            if (sum < 1e5f)
-              DrawText(TextFormat("%.1f", sum),
-                  int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
-          }
-      });
-    });
-  ecs.system<const DijkstraMapData>()
+  // labels are only drawn for a few tiles around the cursor, the heatmap carries the rest
+  ecs.system<const DmapHeatmap>()
     .term<VisualiseMap>()
-    .each([](const DijkstraMapData &dmap)
+    .each([&](const DmapHeatmap &heatmap)
     {
-      dungeonDataQuery.each([&](const DungeonData &dd)
-      {
-        for (size_t y = 0; y < dd.height; ++y)
-          for (size_t x = 0; x < dd.width; ++x)
-          {
-            const float val = dmap.map[y * dd.width + x];
-            if (val < 1e5f)
-              DrawText(TextFormat("%.1f", val),
-                  int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
-          }
-      });
+      constexpr int labelRadius = 2;
+      const DungeonData &dd = *ecs.get<DungeonData>();
+      const CursorTile &cursor = *ecs.get<CursorTile>();
+      for (int y = std::max(cursor.y - labelRadius, 0); y <= std::min(cursor.y + labelRadius, int(dd.height) - 1); ++y)
+        for (int x = std::max(cursor.x - labelRadius, 0); x <= std::min(cursor.x + labelRadius, int(dd.width) - 1); ++x)
+        {
+          const float val = heatmap.values[size_t(y) * dd.width + size_t(x)];
+          if (val < 1e5f)
+            DrawText(TextFormat("%.1f", val),
+                int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
+        }
     });
 }
 
@@ -141,17 +197,39 @@ void init_roguelike(flecs::world &ecs)
       {
         UnloadTexture(texture);
       });
+  ecs.observer<DmapHeatmap>()
+    .event(flecs::OnRemove)
+    .each([](DmapHeatmap &heatmap)
+      {
+        UnloadTexture(heatmap.texture);
+      });
+  ecs.observer<Tilemap>()
+    .event(flecs::OnRemove)
+    .each([](Tilemap &tm)
+      {
+        for (RenderTexture2D &rt : tm.chunks)
+          UnloadRenderTexture(rt);
+      });
 
-  create_hive_monster(create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"));
-  create_hive_monster(create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"));
-  create_hive_monster(create_monster(ecs, Color{0x11, 0x11, 0x11, 0xff}, "minotaur_tex"));
-  create_hive(create_player_fleer(create_monster(ecs, Color{0, 255, 0, 255}, "minotaur_tex")));
+  // monsters that found no free tile aren't spawned
+  if (flecs::entity e = create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"))
+    create_hive_monster(e);
+  if (flecs::entity e = create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"))
+    create_hive_monster(e);
+  if (flecs::entity e = create_monster(ecs, Color{0x11, 0x11, 0x11, 0xff}, "minotaur_tex"))
+    create_hive_monster(e);
+  if (flecs::entity e = create_monster(ecs, Color{0, 255, 0, 255}, "minotaur_tex"))
+    create_hive(create_player_fleer(e));
+  for (int i = 0; i < 4; ++i)
+    if (flecs::entity e = create_monster(ecs, Color{0xee, 0x88, 0x00, 0xff}, "minotaur_tex"))
+      create_coop_approacher(e);
 
   create_player(ecs, "swordsman_tex");
 
   ecs.entity("world")
     .set(TurnCounter{})
-    .set(ActionLog{});
+    .set(ActionLog{})
+    .set(ReservationTable{});
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
@@ -161,30 +239,33 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
   flecs::entity floorTex = ecs.entity("floor_tex")
     .set(Texture2D{LoadTexture("assets/floor.png")});
 
-  std::vector<char> dungeonData;
-  dungeonData.resize(w * h);
-  for (size_t y = 0; y < h; ++y)
-    for (size_t x = 0; x < w; ++x)
-      dungeonData[y * w + x] = tiles[y * w + x];
-  ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
-
-  for (size_t y = 0; y < h; ++y)
-    for (size_t x = 0; x < w; ++x)
-    {
-      char tile = tiles[y * w + x];
-      flecs::entity tileEntity = ecs.entity()
-        .add<BackgroundTile>()
-        .set(Position{int(x), int(y)})
-        .set(Color{255, 255, 255, 255});
-      if (tile == dungeon::wall)
-        tileEntity.add<TextureSource>(wallTex);
-      else if (tile == dungeon::floor)
-        tileEntity.add<TextureSource>(floorTex);
-    }
+  const DungeonData dd = dungeon::make_dungeon_data(tiles, w, h);
+  ecs.set(dungeon::make_occupancy(dd));
+  ecs.set(dd);
+  ecs.set(PickupIndex{});
+  ecs.set(VisibleTiles{});
+  ecs.set(CursorTile{});
+  ecs.set(RenderQueue{});
+  ecs.set(create_tilemap(dd, *wallTex.get<Texture2D>(), *floorTex.get<Texture2D>()));
 }
 
 
+void update_visible_tiles(flecs::world &ecs, const Camera2D &camera)
+{
+  const DungeonData &dd = *ecs.get<DungeonData>();
+  const Vector2 topLeft = GetScreenToWorld2D(Vector2{0, 0}, camera);
+  const Vector2 bottomRight = GetScreenToWorld2D(Vector2{float(GetRenderWidth()), float(GetRenderHeight())}, camera);
+  // one extra tile around so hp bars above the view edge still show up
+  ecs.set(VisibleTiles{
+      std::max(int(floorf(topLeft.x / tile_size)) - 1, 0),
+      std::max(int(floorf(topLeft.y / tile_size)) - 1, 0),
+      std::min(int(ceilf(bottomRight.x / tile_size)) + 1, int(dd.width)),
+      std::min(int(ceilf(bottomRight.y / tile_size)) + 1, int(dd.height))});
+
+  const Vector2 cursor = GetScreenToWorld2D(GetMousePosition(), camera);
+  ecs.set(CursorTile{int(floorf(cursor.x / tile_size)), int(floorf(cursor.y / tile_size))});
+}
+
 static bool is_player_acted(flecs::world &ecs)
 {
   static auto processPlayer = ecs.query<const IsPlayer, const Action>();
@@ -236,7 +317,9 @@ static void process_actions(flecs::world &ecs)
 {
   static auto processActions = ecs.query<Action, Position, MovePos, const MeleeDamage, const Team>();
   static auto processHeals = ecs.query<Action, Hitpoints>();
-  static auto checkAttacks = ecs.query<const MovePos, Hitpoints, const Team>();
+  const DungeonData &dd = *ecs.get<DungeonData>();
+  // fetched outside of defer, so writes go to the singleton itself
+  DungeonOccupancy &occ = *ecs.get_mut<DungeonOccupancy>();
   // Process all actions
   ecs.defer([&]
   {
@@ -252,23 +335,30 @@ static void process_actions(flecs::world &ecs)
     processActions.each([&](flecs::entity entity, Action &a, Position &pos, MovePos &mpos, const MeleeDamage &dmg, const Team &team)
     {
       Position nextPos = move_pos(pos, a.action);
-      bool blocked = !dungeon::is_tile_walkable(ecs, nextPos);
-      checkAttacks.each([&](flecs::entity enemy, const MovePos &epos, Hitpoints &hp, const Team &enemy_team)
+      bool blocked = !dd.is_walkable(nextPos.x, nextPos.y);
+      if (!blocked)
       {
-        if (entity != enemy && epos == nextPos)
+        const uint64_t occupant = occ.tiles[size_t(nextPos.y) * occ.width + size_t(nextPos.x)];
+        if (occupant != 0 && occupant != entity)
         {
           blocked = true;
-          if (team.team != enemy_team.team)
+          flecs::entity enemy = ecs.entity(occupant);
+          if (enemy.has<Hitpoints>() && enemy.has<Team>() && team.team != enemy.get<Team>()->team)
           {
             push_to_log(ecs, "damaged entity");
-            hp.hitpoints -= dmg.damage;
+            // ref writes to storage directly, get_mut would be deferred and lose repeated hits
+            enemy.get_ref<Hitpoints>()->hitpoints -= dmg.damage;
           }
         }
-      });
+      }
       if (blocked)
         a.action = EA_NOP;
       else
+      {
+        dungeon::vacate(occ, Position{mpos.x, mpos.y}, entity);
+        dungeon::occupy(occ, nextPos, entity);
         mpos = nextPos;
+      }
     });
     // now move
     processActions.each([&](Action &a, Position &pos, MovePos &mpos, const MeleeDamage &, const Team&)
@@ -289,28 +379,21 @@ static void process_actions(flecs::world &ecs)
   });
 
   static auto playerPickup = ecs.query<const IsPlayer, const Position, Hitpoints, MeleeDamage>();
-  static auto healPickup = ecs.query<const Position, const HealAmount>();
-  static auto powerupPickup = ecs.query<const Position, const PowerupAmount>();
+  const PickupIndex &pi = *ecs.get<PickupIndex>();
   ecs.defer([&]
   {
     playerPickup.each([&](const IsPlayer&, const Position &pos, Hitpoints &hp, MeleeDamage &dmg)
     {
-      healPickup.each([&](flecs::entity entity, const Position &ppos, const HealAmount &amt)
+      auto range = pi.pickups.equal_range(tile_key(pos));
+      for (auto it = range.first; it != range.second; ++it)
       {
-        if (pos == ppos)
-        {
-          hp.hitpoints += amt.amount;
-          entity.destruct();
-        }
-      });
-      powerupPickup.each([&](flecs::entity entity, const Position &ppos, const PowerupAmount &amt)
-      {
-        if (pos == ppos)
-        {
-          dmg.damage += amt.amount;
-          entity.destruct();
-        }
-      });
+        flecs::entity pickup = ecs.entity(it->second);
+        if (const HealAmount *amt = pickup.get<HealAmount>())
+          hp.hitpoints += amt->amount;
+        if (const PowerupAmount *amt = pickup.get<PowerupAmount>())
+          dmg.damage += amt->amount;
+        pickup.destruct();
+      }
     });
   });
 }
@@ -376,6 +459,7 @@ void process_turn(flecs::world &ecs)
           bt.update(ecs, e, bb);
         });
         process_dmap_followers(ecs);
+        process_coop_path_agents(ecs);
       });
       turnIncrementer.each([](TurnCounter &tc) { tc.count++; });
     }
@@ -400,6 +484,7 @@ void process_turn(flecs::world &ecs)
     ecs.entity("hive_follower_sum")
       .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}})
       .add<VisualiseMap>();
+    bake_dmap_heatmaps(ecs);
   }
 }
 
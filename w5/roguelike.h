@@ -1,6 +1,7 @@
 #pragma once
 
 #include <flecs.h>
+#include "raylib.h"
 
 constexpr float tile_size = 512.f;
 
@@ -8,3 +9,4 @@ void init_roguelike(flecs::world &ecs);
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
 void process_turn(flecs::world &ecs);
 void print_stats(flecs::world &ecs);
+void update_visible_tiles(flecs::world &ecs, const Camera2D &camera);
@@ -0,0 +1,65 @@
+#include "tilemap.h"
+#include "dungeonUtils.h"
+#include "roguelike.h"
+#include <algorithm>
+
+constexpr int chunk_texels = int(tilemap_chunk_size) * tilemap_texels_per_tile;
+
+static void draw_tile_texture(Texture2D tex, int x, int y)
+{
+  DrawTexturePro(tex, Rectangle{0, 0, float(tex.width), float(tex.height)},
+      Rectangle{float(x * tilemap_texels_per_tile), float(y * tilemap_texels_per_tile),
+                float(tilemap_texels_per_tile), float(tilemap_texels_per_tile)},
+      Vector2{0, 0}, 0.f, WHITE);
+}
+
+Tilemap create_tilemap(const DungeonData &dd, Texture2D wall_tex, Texture2D floor_tex)
+{
+  Tilemap tm;
+  tm.chunksX = (dd.width + tilemap_chunk_size - 1) / tilemap_chunk_size;
+  tm.chunksY = (dd.height + tilemap_chunk_size - 1) / tilemap_chunk_size;
+  SetTextureFilter(wall_tex, TEXTURE_FILTER_POINT);
+  SetTextureFilter(floor_tex, TEXTURE_FILTER_POINT);
+  for (size_t cy = 0; cy < tm.chunksY; ++cy)
+    for (size_t cx = 0; cx < tm.chunksX; ++cx)
+    {
+      RenderTexture2D rt = LoadRenderTexture(chunk_texels, chunk_texels);
+      BeginTextureMode(rt);
+        ClearBackground(BLANK);
+        for (size_t ly = 0; ly < tilemap_chunk_size; ++ly)
+          for (size_t lx = 0; lx < tilemap_chunk_size; ++lx)
+          {
+            const size_t x = cx * tilemap_chunk_size + lx;
+            const size_t y = cy * tilemap_chunk_size + ly;
+            if (x >= dd.width || y >= dd.height)
+              continue;
+            const char tile = dd.tiles[y * dd.width + x];
+            if (tile == dungeon::wall)
+              draw_tile_texture(wall_tex, int(lx), int(ly));
+            else if (tile == dungeon::floor)
+              draw_tile_texture(floor_tex, int(lx), int(ly));
+          }
+      EndTextureMode();
+      SetTextureFilter(rt.texture, TEXTURE_FILTER_POINT);
+      tm.chunks.push_back(rt);
+    }
+  return tm;
+}
+
+void push_tilemap(RenderQueue &rq, const Tilemap &tm, const VisibleTiles &vis)
+{
+  constexpr float chunk_world_size = float(tilemap_chunk_size) * tile_size;
+  if (vis.maxX <= vis.minX || vis.maxY <= vis.minY)
+    return;
+  const size_t maxCx = std::min(size_t(vis.maxX - 1) / tilemap_chunk_size + 1, tm.chunksX);
+  const size_t maxCy = std::min(size_t(vis.maxY - 1) / tilemap_chunk_size + 1, tm.chunksY);
+  for (size_t cy = size_t(vis.minY) / tilemap_chunk_size; cy < maxCy; ++cy)
+    for (size_t cx = size_t(vis.minX) / tilemap_chunk_size; cx < maxCx; ++cx)
+    {
+      const Texture2D &tex = tm.chunks[cy * tm.chunksX + cx].texture;
+      // render textures are stored upside down
+      push_sprite(rq, RL_BACKGROUND, tex, Rectangle{0, 0, float(tex.width), -float(tex.height)},
+          Rectangle{float(cx) * chunk_world_size, float(cy) * chunk_world_size, chunk_world_size, chunk_world_size},
+          WHITE);
+    }
+}
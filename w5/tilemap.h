@@ -0,0 +1,20 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include "raylib.h"
+#include "ecsTypes.h"
+#include "renderQueue.h"
+
+// Static dungeon background, baked into one render texture per chunk of tiles
+struct Tilemap
+{
+  std::vector<RenderTexture2D> chunks;
+  size_t chunksX = 0;
+  size_t chunksY = 0;
+};
+
+constexpr size_t tilemap_chunk_size = 16; // in tiles
+constexpr int tilemap_texels_per_tile = 64;
+
+Tilemap create_tilemap(const DungeonData &dd, Texture2D wall_tex, Texture2D floor_tex);
+void push_tilemap(RenderQueue &rq, const Tilemap &tm, const VisibleTiles &vis);
@@ -185,3 +185,10 @@ struct DmapWeights
 };
 
 struct Hive {};
+
+// Singleton snapshot of everything steering agents and spawners target (players), filled once per frame
+struct SteerTargets
+{
+  std::vector<Position> positions;
+  std::vector<Velocity> velocities;
+};
@@ -4,15 +4,20 @@
 
 #include "ecsTypes.h"
 #include "shootEmUp.h"
+#include "steering.h"
 
-static void update_camera(Camera2D &cam, flecs::world &ecs)
+static void update_camera(flecs::world &ecs)
 {
+  static auto cameraQuery = ecs.query<Camera2D>();
   static auto playerQuery = ecs.query<const Position, const IsPlayer>();
 
-  playerQuery.each([&](const Position &pos, const IsPlayer &)
+  cameraQuery.each([&](Camera2D &cam)
   {
-    cam.target.x += (pos.x - cam.target.x) * 0.1f;
-    cam.target.y += (pos.y - cam.target.y) * 0.1f;
+    playerQuery.each([&](const Position &pos, const IsPlayer &)
+    {
+      cam.target.x += (pos.x - cam.target.x) * 0.1f;
+      cam.target.y += (pos.y - cam.target.y) * 0.1f;
+    });
   });
 }
 
@@ -42,22 +47,26 @@ int main(int /*argc*/, const char ** /*argv*/)
   camera.offset = Vector2{ width * 0.5f, height * 0.5f };
   camera.rotation = 0.f;
   camera.zoom = 1.f;
+  ecs.entity("camera")
+    .set(Camera2D{camera});
 
   SetTargetFPS(60);               // Set our game to run at 60 frames-per-second
   while (!WindowShouldClose())
   {
+    static auto cameraQuery = ecs.query<Camera2D>();
     process_game(ecs);
-    update_camera(camera, ecs);
+    update_camera(ecs);
 
     BeginDrawing();
       ClearBackground(BLACK);
-      BeginMode2D(camera);
+      cameraQuery.each([&](Camera2D &cam) { BeginMode2D(cam); });
         //DrawTextureTiled(bgTex, {0, 0, 512, 512}, {0, 0, 10240, 10240}, {0, 0}, 0.f, 1.f, WHITE);
         constexpr int tiles = 20;
         DrawTextureQuad(bgTex, {tiles, tiles}, {0, 0},
             {-512 * tiles / 2, -512 * tiles / 2, 512 * tiles, 512 * tiles}, GRAY);
         ecs.progress();
       EndMode2D();
+      steer::print_stats(ecs);
       // Advance to next frame. Process submitted rendering primitives.
     EndDrawing();
   }
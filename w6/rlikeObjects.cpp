@@ -17,6 +17,46 @@ flecs::entity create_monster(flecs::world &ecs, Position pos, Color col, const c
     .set(MeleeDamage{20.f});
 }
 
+flecs::entity create_monster_prefab(flecs::world &ecs, steer::Type type, Color col, const char *texture_src)
+{
+  flecs::entity textureSrc = ecs.entity(texture_src);
+  // everything is overridden so instances own their data and are created
+  // right in their final archetype instead of moving on every set
+  flecs::entity prefab = ecs.prefab()
+    .set_override(Position{0.f, 0.f})
+    .set_override(Velocity{0.f, 0.f})
+    .set_override(MoveSpeed{100.f})
+    .set_override(Hitpoints{100.f})
+    .set_override(Action{EA_NOP})
+    .set_override(Color{col})
+    .override<TextureSource>(textureSrc)
+    .set_override(Team{1})
+    .set_override(NumActions{1, 0})
+    .set_override(MeleeDamage{20.f})
+    .set_override(PooledMonster{type});
+  return steer::create_steer_prefab(prefab, type);
+}
+
+flecs::entity spawn_pooled_monster(flecs::world &ecs, MonsterSpawner &ms, steer::Type type, Position pos)
+{
+  std::vector<flecs::entity> &pool = ms.pool[type];
+  flecs::entity e;
+  if (pool.empty())
+    e = ecs.entity().is_a(ms.prefabs[type]);
+  else
+  {
+    e = pool.back();
+    pool.pop_back();
+    e.enable();
+  }
+  ms.numActive++;
+  return e
+    .set(Position{pos.x, pos.y})
+    .set(Velocity{0.f, 0.f})
+    .set(SteerDir{0.f, 0.f})
+    .set(Hitpoints{100.f});
+}
+
 void create_player(flecs::world &ecs, Position pos, const char *texture_src)
 {
   flecs::entity textureSrc = ecs.entity(texture_src);
@@ -34,4 +74,3 @@ void create_player(flecs::world &ecs, Position pos, const char *texture_src)
     .add<TextureSource>(textureSrc)
     .set(MeleeDamage{50.f});
 }
-
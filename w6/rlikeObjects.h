@@ -1,14 +1,31 @@
 #pragma once
 #include <flecs.h>
+#include <vector>
 #include "raylib.h"
 #include "ecsTypes.h"
+#include "steering.h"
+
+struct MonsterSpawner;
 
 flecs::entity create_monster(flecs::world &ecs, Position pos, Color col, const char *texture_src);
+flecs::entity create_monster_prefab(flecs::world &ecs, steer::Type type, Color col, const char *texture_src);
+flecs::entity spawn_pooled_monster(flecs::world &ecs, MonsterSpawner &ms, steer::Type type, Position pos);
 void create_player(flecs::world &ecs, Position pos, const char *texture_src);
 
+struct PooledMonster
+{
+  steer::Type type;
+};
+
 struct MonsterSpawner
 {
   float timeToSpawn;
   float timeBetweenSpawns;
+  size_t maxMonsters = 300;
+  float despawnRadius = 2000.f;
+
+  size_t numActive = 0;
+  flecs::entity prefabs[steer::Type::Num];
+  std::vector<flecs::entity> pool[steer::Type::Num]; // disabled monsters ready to be reused
 };
 
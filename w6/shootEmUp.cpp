@@ -8,7 +8,7 @@ constexpr float tile_size = 64.f;
 
 static void register_roguelike_systems(flecs::world &ecs)
 {
-  static auto playerPosQuery = ecs.query<const Position, const IsPlayer>();
+  static auto playerPosQuery = ecs.query<const Position, const Velocity, const IsPlayer>();
 
   ecs.system<Velocity, const MoveSpeed, const IsPlayer>()
     .each([&](Velocity &vel, const MoveSpeed &ms, const IsPlayer)
@@ -26,6 +26,18 @@ static void register_roguelike_systems(flecs::world &ecs)
     {
       pos += vel * ecs.delta_time();
     });
+  ecs.set(SteerTargets{});
+  ecs.system<SteerTargets>()
+    .each([&](SteerTargets &targets)
+    {
+      targets.positions.clear();
+      targets.velocities.clear();
+      playerPosQuery.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
+      {
+        targets.positions.push_back(pp);
+        targets.velocities.push_back(pvel);
+      });
+    });
   ecs.system<const Position, const Color>()
     .term<TextureSource>(flecs::Wildcard)
     .term<BackgroundTile>()
@@ -53,26 +65,44 @@ static void register_roguelike_systems(flecs::world &ecs)
       SetTextureFilter(tex, TEXTURE_FILTER_POINT);
     });
 
+  static auto pooledMonstersQuery = ecs.query<const Position, const Hitpoints, const PooledMonster>();
   ecs.system<MonsterSpawner>()
     .each([&](MonsterSpawner &ms)
     {
-      playerPosQuery.each([&](const Position &pp, const IsPlayer &)
+      const SteerTargets &targets = *ecs.get<SteerTargets>();
+      if (targets.positions.empty())
+        return;
+      // return dead and far away from every target monsters to the pool
+      const float despawnDistSq = ms.despawnRadius * ms.despawnRadius;
+      ms.numActive = 0;
+      pooledMonstersQuery.each([&](flecs::entity e, const Position &p, const Hitpoints &hp, const PooledMonster &pm)
       {
-        ms.timeToSpawn -= ecs.delta_time();
-        while (ms.timeToSpawn < 0.f)
+        bool nearTarget = false;
+        for (const Position &tp : targets.positions)
+          nearTarget |= length_sq(p - tp) < despawnDistSq;
+        if (hp.hitpoints > 0.f && nearTarget)
         {
-          steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
-          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
-          const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
-          const float dist = distances[st];
-          constexpr int angRandMax = 1 << 16;
-          const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
-          Color col = colors[st];
-          steer::create_steer_beh(create_monster(ecs,
-              {pp.x + cosf(angle) * dist, pp.y + sinf(angle) * dist}, col, "minotaur_tex"), st);
-          ms.timeToSpawn += ms.timeBetweenSpawns;
+          ms.numActive++;
+          return;
         }
+        e.disable();
+        ms.pool[pm.type].push_back(e);
       });
+
+      ms.timeToSpawn -= ecs.delta_time();
+      while (ms.timeToSpawn < 0.f)
+      {
+        ms.timeToSpawn += ms.timeBetweenSpawns;
+        if (ms.numActive >= ms.maxMonsters)
+          continue;
+        const Position &pp = targets.positions[size_t(GetRandomValue(0, int(targets.positions.size()) - 1))];
+        steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
+        const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
+        const float dist = distances[st];
+        constexpr int angRandMax = 1 << 16;
+        const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
+        spawn_pooled_monster(ecs, ms, st, {pp.x + cosf(angle) * dist, pp.y + sinf(angle) * dist});
+      }
     });
   steer::register_systems(ecs);
 }
@@ -95,7 +125,11 @@ void init_shoot_em_up(flecs::world &ecs)
 
   create_player(ecs, {0, 0}, "swordsman_tex");
 
-  ecs.entity().set(MonsterSpawner{0.f, 0.1f});
+  MonsterSpawner spawner{0.f, 0.1f};
+  const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
+  for (int st = 0; st < steer::Type::Num; ++st)
+    spawner.prefabs[st] = create_monster_prefab(ecs, steer::Type(st), colors[st], "minotaur_tex");
+  ecs.entity().set(spawner);
 }
 
 void process_game(flecs::world &ecs)
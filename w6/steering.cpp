@@ -1,5 +1,6 @@
 #include "steering.h"
 #include "ecsTypes.h"
+#include "raylib.h"
 
 struct Seeker {};
 struct Pursuer {};
@@ -11,6 +12,86 @@ struct Cohesion {};
 
 struct SteerAccel { float accel = 1.f; };
 
+// Level of detail for steering: agents in view are steered every frame with all behaviours,
+// agents out of view only every lodFarPeriod-th frame (staggered by entity id),
+// and past lodSimpleDist they only seek/flee the target without flocking or prediction.
+struct SteerLod
+{
+  bool update = true;
+  bool simple = false;
+};
+
+// camera view read once per frame for all agents
+struct SteerLodView
+{
+  Position center{0.f, 0.f};
+  float halfWidth = 0.f;
+  float halfHeight = 0.f;
+  uint64_t frame = 0;
+};
+
+constexpr float lodViewMargin = 200.f;
+constexpr float lodSimpleDist = 1500.f;
+constexpr uint64_t lodFarPeriod = 4;
+
+// Verlet neighbour lists: every agent caches all others within the widest steering radius
+// plus a skin, lists are rebuilt only once someone moved more than half the skin since the last build.
+// Simple LOD agents don't flock, so they're left out and the cost tracks agents within lodSimpleDist
+// of the camera. Out of view ones within it stay in, they're still neighbours of the ones in view.
+constexpr float neighbourMaxDist = 500.f; // cohesion
+constexpr float neighbourSkin = 100.f;
+
+struct NeighbourCache
+{
+  // snapshot of all flocking agents for the current frame
+  std::vector<flecs::entity> entities;
+  std::vector<Position> positions;
+  std::vector<Velocity> velocities;
+
+  std::vector<Position> buildPositions;
+  std::vector<std::vector<uint32_t>> neighbours;
+  std::unordered_map<flecs::entity_t, uint32_t> indices;
+
+  // rebuild rate stats
+  size_t frames = 0;
+  size_t rebuilds = 0;
+  float reportTime = 0.f;
+  // last report, shown by steer::print_stats
+  float rebuildPercent = 0.f;
+  size_t reportAgents = 0;
+};
+
+template<typename Callable>
+static void for_each_neighbour(flecs::world &ecs, flecs::entity e, Callable c)
+{
+  const NeighbourCache *nc = ecs.get<NeighbourCache>();
+  auto it = nc->indices.find(e.id());
+  if (it == nc->indices.end())
+    return;
+  for (uint32_t idx : nc->neighbours[it->second])
+    c(nc->positions[idx], nc->velocities[idx]);
+}
+
+template<typename Callable>
+static void on_closest_target(flecs::world &ecs, const Position &p, Callable c)
+{
+  const SteerTargets *targets = ecs.get<SteerTargets>();
+  if (targets->positions.empty())
+    return;
+  size_t closestIdx = 0;
+  float closestDistSq = length_sq(targets->positions[0] - p);
+  for (size_t i = 1; i < targets->positions.size(); ++i)
+  {
+    const float distSq = length_sq(targets->positions[i] - p);
+    if (distSq < closestDistSq)
+    {
+      closestDistSq = distSq;
+      closestIdx = i;
+    }
+  }
+  c(targets->positions[closestIdx], targets->velocities[closestIdx]);
+}
+
 static flecs::entity create_separation(flecs::entity e)
 {
   return e.add<Separation>();
@@ -30,7 +111,7 @@ static flecs::entity create_steerer(flecs::entity e)
 {
   return create_cohesion(
       create_alignment(
-        create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}))
+        create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}).set(SteerLod{}))
         )
       );
 }
@@ -69,60 +150,129 @@ flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
   return steerFoo[type](e);
 }
 
+template<typename Beh>
+static flecs::entity override_beh(flecs::entity e)
+{
+  return e.override<Beh>();
+}
 
-void steer::register_systems(flecs::world &ecs)
+flecs::entity steer::create_steer_prefab(flecs::entity prefab, Type type)
 {
-  static auto playerPosQuery = ecs.query<const Position, const Velocity, const IsPlayer>();
+  // instances write their own steer dir every frame, nothing should be shared through the prefab
+  create_foo overrideFoo[Type::Num] =
+  {
+    override_beh<Seeker>,
+    override_beh<Pursuer>,
+    override_beh<Evader>,
+    override_beh<Fleer>
+  };
+  return overrideFoo[type](create_steer_beh(prefab, type))
+    .override<SteerDir>()
+    .override<SteerAccel>()
+    .override<SteerLod>()
+    .override<Separation>()
+    .override<Alignment>()
+    .override<Cohesion>();
+}
+
 
+void steer::register_systems(flecs::world &ecs)
+{
   ecs.system<Velocity, const MoveSpeed, const SteerDir, const SteerAccel>()
     .each([&](Velocity &vel, const MoveSpeed &ms, const SteerDir &sd, const SteerAccel &sa)
     {
       vel = Velocity{truncate(vel + truncate(sd, ms.speed) * ecs.delta_time() * sa.accel, ms.speed)};
     });
 
-  // reset steer dir
-  ecs.system<SteerDir>().each([&](SteerDir &sd) { sd = {0.f, 0.f}; });
+  static auto cameraQuery = ecs.query<const Camera2D>();
+  ecs.set(SteerLodView{});
+  ecs.system<SteerLodView>()
+    .each([&](SteerLodView &view)
+    {
+      view.frame = uint64_t(ecs.get_info()->frame_count_total);
+      cameraQuery.each([&](const Camera2D &cam)
+      {
+        view.center = Position{cam.target.x, cam.target.y};
+        view.halfWidth = cam.offset.x / cam.zoom + lodViewMargin;
+        view.halfHeight = cam.offset.y / cam.zoom + lodViewMargin;
+      });
+    });
+
+  ecs.system<SteerLod, const Position, const SteerLodView>()
+    .term_at(3).singleton()
+    .each([&](flecs::entity e, SteerLod &lod, const Position &p, const SteerLodView &view)
+    {
+      lod = SteerLod{};
+      const Position delta = p - view.center;
+      if (fabsf(delta.x) <= view.halfWidth && fabsf(delta.y) <= view.halfHeight)
+        return;
+      lod.update = (view.frame + e.id()) % lodFarPeriod == 0;
+      lod.simple = length_sq(delta) > lodSimpleDist * lodSimpleDist;
+    });
+
+  // reset steer dir, agents skipping this frame keep the last one
+  ecs.system<SteerDir, const SteerLod>()
+    .each([&](SteerDir &sd, const SteerLod &lod)
+    {
+      if (lod.update)
+        sd = {0.f, 0.f};
+    });
 
   // seeker
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Seeker>()
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const SteerLod, const Seeker>()
     .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel,
-              const Position &p, const Seeker &)
+              const Position &p, const SteerLod &lod, const Seeker &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
+      if (!lod.update)
+        return;
+      on_closest_target(ecs, p, [&](const Position &pp, const Velocity &)
       {
         sd += SteerDir{normalize(pp - p) * ms.speed - vel};
       });
     });
 
   // fleer
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Fleer>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Fleer &)
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const SteerLod, const Fleer>()
+    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p,
+              const SteerLod &lod, const Fleer &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
+      if (!lod.update)
+        return;
+      on_closest_target(ecs, p, [&](const Position &pp, const Velocity &)
       {
         sd += SteerDir{normalize(p - pp) * ms.speed - vel};
       });
     });
 
   // pursuer
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Pursuer>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Pursuer &)
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const SteerLod, const Pursuer>()
+    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p,
+              const SteerLod &lod, const Pursuer &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
+      if (!lod.update)
+        return;
+      on_closest_target(ecs, p, [&](const Position &pp, const Velocity &pvel)
       {
-        constexpr float predictTime = 4.f;
+        const float predictTime = lod.simple ? 0.f : 4.f;
         const Position targetPos = pp + pvel * predictTime;
         sd += SteerDir{normalize(targetPos - p) * ms.speed - vel};
       });
     });
 
   // evader
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Evader>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Evader &)
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const SteerLod, const Evader>()
+    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p,
+              const SteerLod &lod, const Evader &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &pvel,
-                              const IsPlayer &)
+      if (!lod.update)
+        return;
+      on_closest_target(ecs, p, [&](const Position &pp, const Velocity &pvel)
       {
+        if (lod.simple)
+        {
+          sd += SteerDir{normalize(p - pp) * ms.speed - vel};
+          return;
+        }
         constexpr float maxPredictTime = 4.f;
         const Position dpos = p - pp;
         const float dist = length(dpos);
@@ -136,17 +286,86 @@ void steer::register_systems(flecs::world &ecs)
       });
     });
 
-  static auto otherPosQuery = ecs.query<const Position>();
+  // agents without lod (the player) are always kept
+  static auto otherVelQuery = ecs.query<const Position, const Velocity, const SteerLod*>();
+  ecs.set(NeighbourCache{});
+  ecs.system<NeighbourCache>()
+    .each([&](NeighbourCache &nc)
+    {
+      // snapshot flocking agents, any change in their set invalidates the lists
+      bool rebuild = false;
+      size_t count = 0;
+      otherVelQuery.each([&](flecs::entity oe, const Position &op, const Velocity &ovel, const SteerLod *olod)
+      {
+        if (olod && olod->simple)
+          return;
+        if (count == nc.entities.size())
+        {
+          nc.entities.push_back(oe);
+          nc.positions.push_back(op);
+          nc.velocities.push_back(ovel);
+          rebuild = true;
+        }
+        else
+        {
+          rebuild |= nc.entities[count] != oe;
+          nc.entities[count] = oe;
+          nc.positions[count] = op;
+          nc.velocities[count] = ovel;
+        }
+        count++;
+      });
+      rebuild |= count != nc.entities.size();
+      nc.entities.resize(count);
+      nc.positions.resize(count);
+      nc.velocities.resize(count);
+
+      constexpr float maxDisplacement = neighbourSkin * 0.5f;
+      for (size_t i = 0; i < count && !rebuild; ++i)
+        rebuild = length_sq(nc.positions[i] - nc.buildPositions[i]) > maxDisplacement * maxDisplacement;
+
+      nc.frames++;
+      if (rebuild)
+      {
+        nc.rebuilds++;
+        nc.buildPositions = nc.positions;
+        nc.indices.clear();
+        nc.neighbours.resize(count);
+        for (std::vector<uint32_t> &list : nc.neighbours)
+          list.clear();
+        constexpr float listDist = neighbourMaxDist + neighbourSkin;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+          nc.indices[nc.entities[i].id()] = i;
+          for (uint32_t j = i + 1; j < count; ++j)
+            if (length_sq(nc.positions[j] - nc.positions[i]) < listDist * listDist)
+            {
+              nc.neighbours[i].push_back(j);
+              nc.neighbours[j].push_back(i);
+            }
+        }
+      }
+
+      nc.reportTime += ecs.delta_time();
+      if (nc.reportTime >= 1.f)
+      {
+        nc.rebuildPercent = 100.f * float(nc.rebuilds) * safeinv(float(nc.frames));
+        nc.reportAgents = count;
+        nc.reportTime = 0.f;
+        nc.frames = 0;
+        nc.rebuilds = 0;
+      }
+    });
 
   // separation is expensive!!!
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Separation>()
+  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const SteerLod, const Separation>()
     .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Separation &)
+              const Position &p, const SteerLod &lod, const Separation &)
     {
-      otherPosQuery.each([&](flecs::entity oe, const Position &op)
+      if (!lod.update || lod.simple)
+        return;
+      for_each_neighbour(ecs, ent, [&](const Position &op, const Velocity &)
       {
-        if (oe == ent)
-          return;
         constexpr float thresDist = 70.f;
         constexpr float thresDistSq = thresDist * thresDist;
         const float distSq = length_sq(op - p);
@@ -156,15 +375,14 @@ void steer::register_systems(flecs::world &ecs)
       });
     });
 
-  static auto otherVelQuery = ecs.query<const Position, const Velocity>();
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Alignment>()
+  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const SteerLod, const Alignment>()
     .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Alignment &)
+              const Position &p, const SteerLod &lod, const Alignment &)
     {
-      otherVelQuery.each([&](flecs::entity oe, const Position &op, const Velocity &ovel)
+      if (!lod.update || lod.simple)
+        return;
+      for_each_neighbour(ecs, ent, [&](const Position &op, const Velocity &ovel)
       {
-        if (oe == ent)
-          return;
         constexpr float thresDist = 100.f;
         constexpr float thresDistSq = thresDist * thresDist;
         const float distSq = length_sq(op - p);
@@ -174,17 +392,17 @@ void steer::register_systems(flecs::world &ecs)
       });
     });
 
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Cohesion>()
+  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const SteerLod, const Cohesion>()
     .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Cohesion &)
+              const Position &p, const SteerLod &lod, const Cohesion &)
     {
+      if (!lod.update || lod.simple)
+        return;
       Position avgPos{0.f, 0.f};
       size_t count = 0;
-      otherPosQuery.each([&](flecs::entity oe, const Position &op)
+      for_each_neighbour(ecs, ent, [&](const Position &op, const Velocity &)
       {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 500.f;
+        constexpr float thresDist = neighbourMaxDist;
         constexpr float thresDistSq = thresDist * thresDist;
         const float distSq = length_sq(op - p);
         if (distSq > thresDistSq)
@@ -198,3 +416,9 @@ void steer::register_systems(flecs::world &ecs)
 
 }
 
+void steer::print_stats(flecs::world &ecs)
+{
+  if (const NeighbourCache *nc = ecs.get<NeighbourCache>())
+    DrawText(TextFormat("neighbour lists: %.1f%% frames rebuilt, %d flocking agents", nc->rebuildPercent, int(nc->reportAgents)),
+             20, 20, 20, WHITE);
+}
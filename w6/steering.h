@@ -13,6 +13,7 @@ namespace steer
   };
 
   flecs::entity create_steer_beh(flecs::entity e, Type type);
+  flecs::entity create_steer_prefab(flecs::entity prefab, Type type);
 
   flecs::entity create_seeker(flecs::entity e);
   flecs::entity create_pursuer(flecs::entity e);
@@ -20,5 +21,6 @@ namespace steer
   flecs::entity create_fleer(flecs::entity e);
 
   void register_systems(flecs::world &ecs);
+  void print_stats(flecs::world &ecs);
 };
 
@@ -0,0 +1,112 @@
+#include "distanceField.h"
+#include "dungeonUtils.h"
+#include "math.h"
+#include <algorithm>
+#include <limits>
+
+// distance from each tile center to the closest tile center of the other kind,
+// two pass propagation of the closest seed (dead reckoning)
+static std::vector<float> find_seed_distances(const DungeonData &dd, bool seeds_are_walls)
+{
+  const size_t w = dd.width;
+  const size_t h = dd.height;
+  std::vector<float> res(w * h, std::numeric_limits<float>::max());
+  std::vector<IVec2> closest(w * h, IVec2{-1, -1});
+  for (size_t y = 0; y < h; ++y)
+    for (size_t x = 0; x < w; ++x)
+      if ((dd.tiles[y * w + x] == dungeon::wall) == seeds_are_walls)
+      {
+        res[y * w + x] = 0.f;
+        closest[y * w + x] = IVec2{int(x), int(y)};
+      }
+
+  auto relax = [&](int x, int y, int dx, int dy)
+  {
+    const int nx = x + dx;
+    const int ny = y + dy;
+    if (nx < 0 || ny < 0 || nx >= int(w) || ny >= int(h))
+      return;
+    const IVec2 seed = closest[size_t(ny) * w + size_t(nx)];
+    if (seed == IVec2{-1, -1})
+      return;
+    const float d = dist(IVec2{x, y}, seed);
+    const size_t idx = size_t(y) * w + size_t(x);
+    if (d < res[idx])
+    {
+      res[idx] = d;
+      closest[idx] = seed;
+    }
+  };
+  for (int y = 0; y < int(h); ++y)
+    for (int x = 0; x < int(w); ++x)
+    {
+      relax(x, y, -1, -1);
+      relax(x, y, 0, -1);
+      relax(x, y, 1, -1);
+      relax(x, y, -1, 0);
+    }
+  for (int y = int(h) - 1; y >= 0; --y)
+    for (int x = int(w) - 1; x >= 0; --x)
+    {
+      relax(x, y, 1, 0);
+      relax(x, y, -1, 1);
+      relax(x, y, 0, 1);
+      relax(x, y, 1, 1);
+    }
+  return res;
+}
+
+void prebuild_distance_field(flecs::world &ecs)
+{
+  auto mapQuery = ecs.query<const DungeonData>();
+
+  ecs.defer([&]()
+  {
+    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    {
+      const size_t w = dd.width;
+      const size_t h = dd.height;
+      const std::vector<float> toWalls = find_seed_distances(dd, true);
+      const std::vector<float> toFloor = find_seed_distances(dd, false);
+
+      DungeonDistanceField df{std::vector<float>(w * h), std::vector<Position>(w * h), w, h};
+      // tile centers are half a tile away from the border between wall and floor
+      constexpr float maxDist = 1e3f;
+      for (size_t i = 0; i < w * h; ++i)
+        df.dist[i] = dd.tiles[i] == dungeon::wall ? -std::min(toFloor[i] - 0.5f, maxDist)
+                                                  : std::min(toWalls[i] - 0.5f, maxDist);
+
+      auto distAt = [&](int x, int y)
+      {
+        x = std::clamp(x, 0, int(w) - 1);
+        y = std::clamp(y, 0, int(h) - 1);
+        return df.dist[size_t(y) * w + size_t(x)];
+      };
+      for (int y = 0; y < int(h); ++y)
+        for (int x = 0; x < int(w); ++x)
+          df.grad[size_t(y) * w + size_t(x)] = normalize(Position{distAt(x + 1, y) - distAt(x - 1, y),
+                                                                  distAt(x, y + 1) - distAt(x, y - 1)});
+      e.set(df);
+    });
+  });
+}
+
+float sample_distance_field(const DungeonDistanceField &df, Position pos, Position &grad)
+{
+  // everything outside of the map is considered a wall
+  const float fx = std::clamp(pos.x, 0.f, float(df.width - 1));
+  const float fy = std::clamp(pos.y, 0.f, float(df.height - 1));
+  const size_t x0 = std::min(size_t(fx), df.width - 2);
+  const size_t y0 = std::min(size_t(fy), df.height - 2);
+  const float tx = fx - float(x0);
+  const float ty = fy - float(y0);
+
+  const size_t i00 = y0 * df.width + x0;
+  const size_t i10 = i00 + 1;
+  const size_t i01 = i00 + df.width;
+  const size_t i11 = i01 + 1;
+  auto lerp = [](auto a, auto b, float t) { return a + (b - a) * t; };
+  grad = normalize(lerp(lerp(df.grad[i00], df.grad[i10], tx), lerp(df.grad[i01], df.grad[i11], tx), ty));
+  const float outside = length(Position{pos.x - fx, pos.y - fy});
+  return lerp(lerp(df.dist[i00], df.dist[i10], tx), lerp(df.dist[i01], df.dist[i11], tx), ty) - outside;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include "ecsTypes.h"
+
+// Signed distance to walls sampled at tile centers, in tiles (negative inside walls)
+struct DungeonDistanceField
+{
+  std::vector<float> dist;
+  std::vector<Position> grad; // normalized, points away from walls
+  size_t width;
+  size_t height;
+};
+
+void prebuild_distance_field(flecs::world &ecs);
+// pos is in tiles, returns bilinearly interpolated distance and gradient
+float sample_distance_field(const DungeonDistanceField &df, Position pos, Position &grad);
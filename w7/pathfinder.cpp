@@ -239,3 +239,167 @@ void prebuild_map(flecs::world &ecs)
   });
 }
 
+
+static IVec2 tile_cluster(IVec2 p, size_t split)
+{
+  return IVec2{p.x / int(split), p.y / int(split)};
+}
+
+static IVec2 portal_tile_in_cluster(const PathPortal &portal, IVec2 cluster, size_t split)
+{
+  // portals span both sides of the border, take the middle of the part inside the cluster
+  const int limMinX = cluster.x * int(split);
+  const int limMinY = cluster.y * int(split);
+  const int fromX = std::max(int(portal.startX), limMinX);
+  const int fromY = std::max(int(portal.startY), limMinY);
+  const int toX = std::min(int(portal.endX), limMinX + int(split) - 1);
+  const int toY = std::min(int(portal.endY), limMinY + int(split) - 1);
+  return IVec2{(fromX + toX) / 2, (fromY + toY) / 2};
+}
+
+static std::vector<IVec2> find_path_in_cluster(const DungeonData &dd, IVec2 from, IVec2 to,
+                                               IVec2 cluster, size_t split)
+{
+  const IVec2 limMin{cluster.x * int(split), cluster.y * int(split)};
+  const IVec2 limMax{limMin.x + int(split), limMin.y + int(split)};
+  return find_path_a_star(dd, from, to, limMin, limMax);
+}
+
+static void append_path(std::vector<IVec2> &res, const std::vector<IVec2> &path)
+{
+  for (const IVec2 &p : path)
+    if (res.empty() || res.back() != p)
+      res.push_back(p);
+}
+
+std::vector<IVec2> find_hierarchical_path(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to)
+{
+  const size_t split = dp.tileSplit;
+  const int clustersWidth = int(dd.width / split);
+  const int clustersHeight = int(dd.height / split);
+  const IVec2 fromCluster = tile_cluster(from, split);
+  const IVec2 toCluster = tile_cluster(to, split);
+  auto isValidCluster = [&](IVec2 c) { return c.x >= 0 && c.y >= 0 && c.x < clustersWidth && c.y < clustersHeight; };
+  if (!isValidCluster(fromCluster) || !isValidCluster(toCluster))
+    return std::vector<IVec2>();
+
+  if (fromCluster == toCluster)
+  {
+    std::vector<IVec2> path = find_path_in_cluster(dd, from, to, fromCluster, split);
+    if (!path.empty())
+      return path;
+  }
+
+  // connect start and goal to the portals of their clusters
+  const size_t numPortals = dp.portals.size();
+  std::vector<float> g(numPortals, std::numeric_limits<float>::max());
+  std::vector<float> f(numPortals, std::numeric_limits<float>::max());
+  std::vector<float> goalCost(numPortals, std::numeric_limits<float>::max());
+  std::vector<int> prev(numPortals, -1);
+  std::vector<bool> closed(numPortals, false);
+  std::vector<size_t> openList;
+
+  auto portalHeuristic = [&](size_t idx)
+  {
+    const PathPortal &portal = dp.portals[idx];
+    return sqrtf(sqr(float(portal.startX + portal.endX) * 0.5f - float(to.x)) +
+                 sqr(float(portal.startY + portal.endY) * 0.5f - float(to.y)));
+  };
+
+  for (size_t idx : dp.tilePortalsIndices[size_t(fromCluster.y * clustersWidth + fromCluster.x)])
+  {
+    const IVec2 portalTile = portal_tile_in_cluster(dp.portals[idx], fromCluster, split);
+    std::vector<IVec2> path = find_path_in_cluster(dd, from, portalTile, fromCluster, split);
+    if (path.empty())
+      continue;
+    g[idx] = float(path.size() - 1);
+    f[idx] = g[idx] + portalHeuristic(idx);
+    openList.push_back(idx);
+  }
+  for (size_t idx : dp.tilePortalsIndices[size_t(toCluster.y * clustersWidth + toCluster.x)])
+  {
+    const IVec2 portalTile = portal_tile_in_cluster(dp.portals[idx], toCluster, split);
+    std::vector<IVec2> path = find_path_in_cluster(dd, portalTile, to, toCluster, split);
+    if (!path.empty())
+      goalCost[idx] = float(path.size() - 1);
+  }
+
+  // search over the portal graph
+  float bestCost = std::numeric_limits<float>::max();
+  int bestPortal = -1;
+  while (!openList.empty())
+  {
+    size_t bestIdx = 0;
+    for (size_t i = 1; i < openList.size(); ++i)
+      if (f[openList[i]] < f[openList[bestIdx]])
+        bestIdx = i;
+    const size_t cur = openList[bestIdx];
+    openList.erase(openList.begin() + bestIdx);
+    if (closed[cur])
+      continue;
+    if (f[cur] >= bestCost)
+      break;
+    closed[cur] = true;
+    if (goalCost[cur] < std::numeric_limits<float>::max() && g[cur] + goalCost[cur] < bestCost)
+    {
+      bestCost = g[cur] + goalCost[cur];
+      bestPortal = int(cur);
+    }
+    for (const PortalConnection &conn : dp.portals[cur].conns)
+    {
+      const float gScore = g[cur] + conn.score;
+      if (gScore >= g[conn.connIdx])
+        continue;
+      g[conn.connIdx] = gScore;
+      f[conn.connIdx] = gScore + portalHeuristic(conn.connIdx);
+      prev[conn.connIdx] = int(cur);
+      openList.push_back(conn.connIdx);
+    }
+  }
+  if (bestPortal < 0)
+    return std::vector<IVec2>();
+
+  std::vector<size_t> portalsPath;
+  for (int idx = bestPortal; idx >= 0; idx = prev[size_t(idx)])
+    portalsPath.insert(portalsPath.begin(), size_t(idx));
+
+  // refine into tiles, each leg lies inside a single cluster
+  auto portalClusters = [&](size_t idx)
+  {
+    const PathPortal &portal = dp.portals[idx];
+    return std::make_pair(tile_cluster(IVec2{int(portal.startX), int(portal.startY)}, split),
+                          tile_cluster(IVec2{int(portal.endX), int(portal.endY)}, split));
+  };
+  std::vector<IVec2> res;
+  IVec2 legCluster = fromCluster;
+  append_path(res, find_path_in_cluster(dd, from, portal_tile_in_cluster(dp.portals[portalsPath[0]], fromCluster, split),
+                                        fromCluster, split));
+  for (size_t i = 0; i < portalsPath.size(); ++i)
+  {
+    const PathPortal &portal = dp.portals[portalsPath[i]];
+    const auto clusters = portalClusters(portalsPath[i]);
+    const IVec2 otherCluster = clusters.first == legCluster ? clusters.second : clusters.first;
+    if (i + 1 == portalsPath.size())
+    {
+      append_path(res, find_path_in_cluster(dd, portal_tile_in_cluster(portal, toCluster, split), to,
+                                            toCluster, split));
+      break;
+    }
+    // next leg goes either across the portal or along the same cluster, whichever connects to the next portal
+    const PathPortal &nextPortal = dp.portals[portalsPath[i + 1]];
+    const auto nextClusters = portalClusters(portalsPath[i + 1]);
+    std::vector<IVec2> leg;
+    for (IVec2 cluster : {otherCluster, legCluster})
+    {
+      if (nextClusters.first != cluster && nextClusters.second != cluster)
+        continue;
+      leg = find_path_in_cluster(dd, portal_tile_in_cluster(portal, cluster, split),
+                                 portal_tile_in_cluster(nextPortal, cluster, split), cluster, split);
+      legCluster = cluster;
+      if (!leg.empty())
+        break;
+    }
+    append_path(res, leg);
+  }
+  return res;
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include <flecs.h>
 #include <vector>
+#include "ecsTypes.h"
+#include "math.h"
 
 struct PortalConnection
 {
@@ -23,4 +25,6 @@ struct DungeonPortals
 };
 
 void prebuild_map(flecs::world &ecs);
+// path in tiles, start and goal are linked to the portal graph of their clusters and the result is refined per cluster
+std::vector<IVec2> find_hierarchical_path(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to);
 
@@ -6,8 +6,7 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "pathfinder.h"
-
-constexpr float tile_size = 64.f;
+#include "distanceField.h"
 
 static void register_roguelike_systems(flecs::world &ecs)
 {
@@ -29,6 +28,24 @@ static void register_roguelike_systems(flecs::world &ecs)
     {
       pos += vel * ecs.delta_time();
     });
+  // push everyone out of walls
+  static auto distanceFieldQuery = ecs.query<const DungeonDistanceField>();
+  ecs.system<Position, Velocity>()
+    .each([&](Position &pos, Velocity &vel)
+    {
+      distanceFieldQuery.each([&](const DungeonDistanceField &df)
+      {
+        constexpr float bodyRadius = 0.4f; // in tiles
+        Position grad;
+        const float d = sample_distance_field(df, pos * (1.f / tile_size), grad);
+        if (d >= bodyRadius)
+          return;
+        pos += grad * ((bodyRadius - d) * tile_size);
+        const float intoWall = vel.x * grad.x + vel.y * grad.y;
+        if (intoWall < 0.f)
+          vel = Velocity{vel - grad * intoWall};
+      });
+    });
   ecs.system<const Position, const Color>()
     .term<TextureSource>(flecs::Wildcard)
     .term<BackgroundTile>()
@@ -152,6 +169,9 @@ void init_shoot_em_up(flecs::world &ecs)
 
   const Position walkableTile = dungeon::find_walkable_tile(ecs);
   create_player(ecs, walkableTile * tile_size, "swordsman_tex");
+
+  for (int i = 0; i < 10; ++i)
+    steer::create_path_follower(create_monster(ecs, dungeon::find_walkable_tile(ecs) * tile_size, WHITE, "minotaur_tex"));
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
@@ -183,6 +203,7 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
         tileEntity.add<TextureSource>(floorTex);
     }
   prebuild_map(ecs);
+  prebuild_distance_field(ecs);
 }
 
 void process_game(flecs::world &ecs)
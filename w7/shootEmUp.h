@@ -1,6 +1,8 @@
 #pragma once
 #include <flecs.h>
 
+constexpr float tile_size = 64.f;
+
 void init_shoot_em_up(flecs::world &ecs);
 void process_game(flecs::world &ecs);
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
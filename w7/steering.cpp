@@ -1,5 +1,9 @@
 #include "steering.h"
 #include "ecsTypes.h"
+#include "shootEmUp.h"
+#include "pathfinder.h"
+#include "distanceField.h"
+#include "math.h"
 
 struct Seeker {};
 struct Pursuer {};
@@ -8,9 +12,37 @@ struct Fleer {};
 struct Separation {};
 struct Alignment {};
 struct Cohesion {};
+struct WallAvoider {};
 
 struct SteerAccel { float accel = 1.f; };
 
+// Follows a hierarchical path to the player. The path is replanned only when the player
+// moves to another cluster (and no more than a few agents replan per frame),
+// waypoints closer than the look-ahead distance are skipped.
+// A failed plan keeps the target cluster invalid and is retried after a delay.
+struct PathFollower
+{
+  std::vector<Position> waypoints;
+  size_t curWaypoint = 0;
+  IVec2 targetCluster{-1, -1};
+  float retryDelay = 0.f;
+};
+
+constexpr float pathLookAhead = 1.5f * tile_size;
+constexpr int maxReplansPerFrame = 4;
+constexpr float pathRetryDelay = 0.5f; // seconds
+
+// world singleton, refilled every frame before path followers run
+struct PathReplanBudget
+{
+  int replansLeft = maxReplansPerFrame;
+};
+
+static IVec2 world_to_tile(const Position &p)
+{
+  return IVec2{int(floorf(p.x / tile_size + 0.5f)), int(floorf(p.y / tile_size + 0.5f))};
+}
+
 static flecs::entity create_separation(flecs::entity e)
 {
   return e.add<Separation>();
@@ -26,11 +58,18 @@ static flecs::entity create_cohesion(flecs::entity e)
   return e.add<Cohesion>();
 }
 
+static flecs::entity create_wall_avoider(flecs::entity e)
+{
+  return e.add<WallAvoider>();
+}
+
 static flecs::entity create_steerer(flecs::entity e)
 {
-  return create_cohesion(
-      create_alignment(
-        create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}))
+  return create_wall_avoider(
+      create_cohesion(
+        create_alignment(
+          create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}))
+          )
         )
       );
 }
@@ -55,6 +94,14 @@ flecs::entity steer::create_fleer(flecs::entity e)
   return create_steerer(e).add<Fleer>();
 }
 
+flecs::entity steer::create_path_follower(flecs::entity e)
+{
+  // no cohesion or alignment, they pull agents off the path and into walls
+  return create_wall_avoider(
+      create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}))
+      ).set(PathFollower{});
+}
+
 typedef flecs::entity (*create_foo)(flecs::entity);
 
 flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
@@ -136,6 +183,71 @@ void steer::register_systems(flecs::world &ecs)
       });
     });
 
+  // path follower
+  ecs.set(PathReplanBudget{});
+  ecs.system<PathReplanBudget>()
+    .each([](PathReplanBudget &budget)
+    {
+      budget.replansLeft = maxReplansPerFrame;
+    });
+  static auto dungeonQuery = ecs.query<const DungeonData, const DungeonPortals>();
+  ecs.system<SteerDir, PathFollower, const MoveSpeed, const Velocity, const Position, PathReplanBudget>()
+    .term_at(6).singleton()
+    .each([&](SteerDir &sd, PathFollower &pf, const MoveSpeed &ms, const Velocity &vel, const Position &p,
+              PathReplanBudget &budget)
+    {
+      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
+      {
+        dungeonQuery.each([&](const DungeonData &dd, const DungeonPortals &dp)
+        {
+          const IVec2 targetTile = world_to_tile(pp);
+          const IVec2 targetCluster{targetTile.x / int(dp.tileSplit), targetTile.y / int(dp.tileSplit)};
+          pf.retryDelay -= ecs.delta_time();
+          if (targetCluster != pf.targetCluster && pf.retryDelay <= 0.f && budget.replansLeft > 0)
+          {
+            budget.replansLeft--;
+            pf.curWaypoint = 0;
+            pf.waypoints.clear();
+            for (const IVec2 &tile : find_hierarchical_path(dd, dp, world_to_tile(p), targetTile))
+              pf.waypoints.push_back(Position{float(tile.x), float(tile.y)} * tile_size);
+            if (pf.waypoints.empty())
+            {
+              pf.targetCluster = IVec2{-1, -1};
+              pf.retryDelay = pathRetryDelay;
+            }
+            else
+            {
+              pf.targetCluster = targetCluster;
+            }
+          }
+        });
+        while (pf.curWaypoint < pf.waypoints.size() &&
+               length_sq(pf.waypoints[pf.curWaypoint] - p) < sqr(pathLookAhead))
+          pf.curWaypoint++;
+        // once the path is done we're in the same cluster as the player, just seek it
+        const Position targetPos = pf.curWaypoint < pf.waypoints.size() ? pf.waypoints[pf.curWaypoint] : pp;
+        sd += SteerDir{normalize(targetPos - p) * ms.speed - vel};
+      });
+    });
+
+  // wall avoidance, cheap lookup into the precomputed distance field instead of raycasts
+  static auto distanceFieldQuery = ecs.query<const DungeonDistanceField>();
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const WallAvoider>()
+    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const WallAvoider &)
+    {
+      distanceFieldQuery.each([&](const DungeonDistanceField &df)
+      {
+        constexpr float lookAheadTime = 0.25f;
+        constexpr float avoidDist = 1.f; // in tiles
+        constexpr float avoidMult = 2.f;
+        Position grad;
+        const float d = sample_distance_field(df, (p + vel * lookAheadTime) * (1.f / tile_size), grad);
+        if (d >= avoidDist)
+          return;
+        sd += SteerDir{grad * (ms.speed * avoidMult * (avoidDist - d) / avoidDist)};
+      });
+    });
+
   static auto otherPosQuery = ecs.query<const Position, const Hitpoints>();
 
   // separation is expensive!!!
@@ -18,6 +18,7 @@ namespace steer
   flecs::entity create_pursuer(flecs::entity e);
   flecs::entity create_evader(flecs::entity e);
   flecs::entity create_fleer(flecs::entity e);
+  flecs::entity create_path_follower(flecs::entity e);
 
   void register_systems(flecs::world &ecs);
 };